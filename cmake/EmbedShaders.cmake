@@ -0,0 +1,66 @@
+# Writes the SPIR-V binaries in SHADERS ('|' separated) to OUTPUT as a C++ header of
+# constexpr word arrays, plus a table of them by source file name. Run with cmake -P.
+#
+#   cmake -DOUTPUT=embedded_shaders.hpp -DSHADERS=a.vert.spv|b.comp.spv -P EmbedShaders.cmake
+
+if (NOT DEFINED OUTPUT OR NOT DEFINED SHADERS)
+  message(FATAL_ERROR "EmbedShaders.cmake needs OUTPUT and SHADERS")
+endif()
+
+string(REPLACE "|" ";" SHADERS "${SHADERS}")
+list(SORT SHADERS)
+
+set(ARRAYS "")
+set(ENTRIES "")
+foreach(SPIRV ${SHADERS})
+  # gaussian_shader.vert.spv is looked up as gaussian_shader.vert
+  get_filename_component(FILE_NAME ${SPIRV} NAME)
+  string(REGEX REPLACE "\\.spv$" "" SHADER_NAME ${FILE_NAME})
+  string(MAKE_C_IDENTIFIER ${SHADER_NAME} IDENTIFIER)
+
+  file(READ ${SPIRV} HEX HEX)
+  string(LENGTH "${HEX}" HEX_LENGTH)
+  math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+  if (HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+    message(FATAL_ERROR "Not a SPIR-V binary: ${SPIRV}")
+  endif()
+
+  # SPIR-V is a stream of little-endian words; 8 to a line
+  string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1, " WORDS "${HEX}")
+  string(REPEAT "0x[0-9a-f]+, " 8 LINE_PATTERN)
+  string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n\t\t\t" WORDS "${WORDS}")
+  string(REPLACE ", \n" ",\n" WORDS "${WORDS}")
+  string(STRIP "${WORDS}" WORDS)
+
+  string(APPEND ARRAYS "\t\tinline constexpr uint32_t ${IDENTIFIER}[] = {\n\t\t\t${WORDS}\n\t\t};\n\n")
+  string(APPEND ENTRIES "\t\t\t{ \"${SHADER_NAME}\", ${IDENTIFIER} },\n")
+endforeach()
+
+set(CONTENT "// Generated by cmake/EmbedShaders.cmake from the SPIR-V compiled from shaders/. Do not edit.
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace vr {
+	namespace embedded_shaders {
+${ARRAYS}		struct Entry {
+			std::string_view name;
+			std::span<const uint32_t> code;
+		};
+
+		inline constexpr Entry entries[] = {
+${ENTRIES}		};
+	}
+}
+")
+
+# Leave the header untouched when nothing changed, so its includers are not rebuilt
+if (EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} EXISTING)
+  if (EXISTING STREQUAL CONTENT)
+    return()
+  endif()
+endif()
+file(WRITE ${OUTPUT} "${CONTENT}")
@@ -1,6 +0,0 @@
-C:\VulkanSDK\1.4.304.0\Bin\glslc.exe shaders\simple_shader.vert -o shaders\simple_shader.vert.spv
-C:\VulkanSDK\1.4.304.0\Bin\glslc.exe shaders\simple_shader.frag -o shaders\simple_shader.frag.spv
-C:\VulkanSDK\1.4.304.0\Bin\glslc.exe shaders\gaussian_shader.vert -o shaders\gaussian_shader.vert.spv
-C:\VulkanSDK\1.4.304.0\Bin\glslc.exe shaders\gaussian_shader.frag -o shaders\gaussian_shader.frag.spv
-C:\VulkanSDK\1.4.304.0\Bin\glslc.exe shaders\preprocess.comp -o shaders\preprocess.comp.spv
-pause
\ No newline at end of file
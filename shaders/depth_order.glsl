@@ -0,0 +1,35 @@
+// Shared by the passes that maintain the depth order of GaussianSortMode::Incremental. Keys are
+// computed from the splat positions rather than preprocess.comp's output, so culled splats keep
+// a place in the order too.
+
+#include "global_ubo.glsl"
+#include "view_set.glsl"
+
+// Must match GaussianRenderSystem::DEPTH_ORDER_BLOCK_SIZE
+const uint DEPTH_ORDER_BLOCK_SIZE = 512u;
+
+struct PositionOpacity {
+	vec3 position;
+	float opacity;
+};
+
+layout (std430, set = 1, binding = 4) readonly buffer Positions {
+	PositionOpacity positions[];
+};
+
+layout (push_constant) uniform Push {
+	mat4 modelMatrix;
+	uint shPrecision;
+	uint splatCount;
+	// Shift of the refine pass's blocks towards the front of the order
+	uint sortBlockOffset;
+} push;
+
+// Ascending key that draws far splats first. View depth is mapped to an unsigned int that
+// orders like the float, splats behind the camera included, and inverted
+uint depthOrderKey(uint splat) {
+	float depth = (ubo.view * (push.modelMatrix * vec4(positions[splat].position, 1.0))).z;
+	uint bits = floatBitsToUint(depth);
+	uint ordered = (bits & 0x80000000u) != 0u ? ~bits : bits | 0x80000000u;
+	return ~ordered;
+}
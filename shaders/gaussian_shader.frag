@@ -1,10 +1,25 @@
 #version 450
 
+// Evaluates the splat's 2D gaussian at this pixel. Output is premultiplied for ONE,
+// ONE_MINUS_SRC_ALPHA blending of splats drawn back to front.
+
+// Contributions below this alpha are discarded; the cap keeps a single splat from saturating.
+// Must match tile_render.comp
+const float MIN_ALPHA = 1.0 / 255.0;
+const float MAX_ALPHA = 0.99;
+
 layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec2 fragOffset;
+layout (location = 2) flat in vec4 fragConicOpacity;
 
-layout(location = 0) out vec4 outColor;
+layout (location = 0) out vec4 outColor;
 
 void main() {
-  // r g b a
-  outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+	vec2 d = fragOffset;
+	float power = -0.5 * (fragConicOpacity.x * d.x * d.x + fragConicOpacity.z * d.y * d.y) - fragConicOpacity.y * d.x * d.y;
+	float alpha = min(MAX_ALPHA, fragConicOpacity.w * exp(power));
+	if (alpha < MIN_ALPHA) {
+		discard;
+	}
+	outColor = vec4(fragColor * alpha, alpha);
+}
@@ -1,27 +1,44 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout (binding = 0) uniform UniformBufferObject {
-	mat4 proj;
-	vec3 dirLight;
-} ubo;
+// One instance per visible splat in sorted order, expanded into a quad along the axes of its
+// projected 2D covariance. Vertices 0-3 form a triangle strip over the corners.
 
-layout (location = 4) in vec3 inPosition;
-layout (location = 5) in vec3 normal;
-layout (location = 6) in vec4 color;
-layout (location = 18) in float opacity;
-layout (location = 19) in vec3 scale;
-layout (location = 20) in vec3 rotation;
+#include "global_ubo.glsl"
+#include "view_set.glsl"
+
+// Quad half-extent along each axis, in standard deviations
+const float QUAD_EXTENT = 3.0;
 
 layout (location = 0) out vec3 fragColor;
+// Offset from the splat center in pixels
+layout (location = 1) out vec2 fragOffset;
+layout (location = 2) flat out vec4 fragConicOpacity;
 
-layout (push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
+void main() {
+	// Culled splats were compacted away, so every instance is visible
+	ProjectedSplat splat = projectedSplats[sortedSplats[gl_InstanceIndex]];
 
-const float AMBIENT = 0.02;
+	// The conic is the inverse covariance; invert it back to get the ellipse axes
+	vec3 conic = splat.conicOpacity.xyz;
+	vec3 cov = vec3(conic.z, -conic.y, conic.x) / (conic.x * conic.z - conic.y * conic.y);
+	float mid = 0.5 * (cov.x + cov.z);
+	float spread = sqrt(max(0.0, mid * mid - (cov.x * cov.z - cov.y * cov.y)));
+	float lambdaMajor = mid + spread;
+	float lambdaMinor = max(mid - spread, 0.0);
 
-void main() {
-	gl_Position = ubo.proj * push.modelMatrix * vec4(inPosition, 1.0);
-	fragColor = vec3(color.x, color.y, color.z);
-}
\ No newline at end of file
+	vec2 majorAxis = abs(cov.y) > 1e-6
+		? normalize(vec2(cov.y, lambdaMajor - cov.x))
+		: (cov.x >= cov.z ? vec2(1.0, 0.0) : vec2(0.0, 1.0));
+	vec2 minorAxis = vec2(-majorAxis.y, majorAxis.x);
+
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+	vec2 offset =
+		corner.x * QUAD_EXTENT * sqrt(lambdaMajor) * majorAxis +
+		corner.y * QUAD_EXTENT * sqrt(lambdaMinor) * minorAxis;
+
+	fragColor = splat.color;
+	fragOffset = offset;
+	fragConicOpacity = splat.conicOpacity;
+	gl_Position = vec4((splat.center.xy + offset) / ubo.viewport * 2.0 - 1.0, splat.center.z, 1.0);
+}
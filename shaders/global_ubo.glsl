@@ -0,0 +1,12 @@
+// Per-frame camera data. Must match GlobalUbo in src/frame_info.hpp
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionView;
+	vec4 lightDirection;
+	mat4 view;
+	mat4 projection;
+	// xyz: world-space camera position
+	vec4 cameraPosition;
+	// Swap chain extent in pixels
+	vec2 viewport;
+} ubo;
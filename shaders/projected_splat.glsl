@@ -0,0 +1,12 @@
+// Per-splat output of preprocess.comp for the current view, read by the draw that follows.
+// Must match ProjectedSplat in src/systems/gaussian_render/gaussian_render.cpp
+
+struct ProjectedSplat {
+	// xy: pixel position, z: NDC depth, w: view-space depth
+	vec4 center;
+	// Inverse 2D covariance (xx, xy, yy) in pixels, and opacity
+	vec4 conicOpacity;
+	vec3 color;
+	// Screen-space extent in pixels, 0 when the splat is culled
+	float radius;
+};
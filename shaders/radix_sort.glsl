@@ -0,0 +1,61 @@
+// Declarations shared by the passes of GpuRadixSort (src/gpu_radix_sort.hpp), which sorts 32- or
+// 64-bit keys with a 32-bit payload least significant digit first. Constants must match the class.
+
+// 32-bit words per key, least significant first
+layout (constant_id = 0) const uint KEY_WORDS = 1u;
+
+const uint RADIX_WORKGROUP_SIZE = 256u;
+// Keys handled by one workgroup, in rounds of RADIX_WORKGROUP_SIZE
+const uint RADIX_ROUNDS_PER_BLOCK = 16u;
+const uint RADIX_BLOCK_SIZE = RADIX_WORKGROUP_SIZE * RADIX_ROUNDS_PER_BLOCK;
+const uint RADIX_BITS = 4u;
+const uint RADIX_SIZE = 1u << RADIX_BITS;
+
+layout (std430, set = 0, binding = 0) readonly buffer KeysIn {
+	uint keysIn[];
+};
+
+layout (std430, set = 0, binding = 1) readonly buffer ValuesIn {
+	uint valuesIn[];
+};
+
+layout (std430, set = 0, binding = 2) writeonly buffer KeysOut {
+	uint keysOut[];
+};
+
+layout (std430, set = 0, binding = 3) writeonly buffer ValuesOut {
+	uint valuesOut[];
+};
+
+// Digit-major: the count of digit d in block b is at d * blockCount + b, so an exclusive scan
+// over the whole array gives every block its first output slot for each digit
+layout (std430, set = 0, binding = 4) buffer Histograms {
+	uint histograms[];
+};
+
+// Written by the producer of the keys when sorting with a GPU-side count
+layout (std430, set = 0, binding = 5) readonly buffer SortCount {
+	uint sortCount;
+};
+
+layout (push_constant) uniform Push {
+	// Number of keys, or the upper bound of sortCount when countFromBuffer is set
+	uint count;
+	// Lowest bit of the digit sorted by this pass
+	uint shift;
+	uint blockCount;
+	uint countFromBuffer;
+} push;
+
+uint keyCount() {
+	return push.countFromBuffer != 0u ? min(sortCount, push.count) : push.count;
+}
+
+// The word of key i holding this pass's digit
+uint digitWord(uint i) {
+	return keysIn[i * KEY_WORDS + push.shift / 32u];
+}
+
+uint radixDigit(uint word) {
+	return (word >> (push.shift % 32u)) & (RADIX_SIZE - 1u);
+}
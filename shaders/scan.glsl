@@ -0,0 +1,48 @@
+// Declarations shared by the passes of GpuScan (src/pipelines/gpu_primitives.hpp), an exclusive
+// prefix sum over uints: per-block totals, a scan of those totals, then a scan within each block
+// starting from its total. Constants must match the class.
+
+const uint SCAN_WORKGROUP_SIZE = 256u;
+const uint SCAN_ITEMS_PER_THREAD = 8u;
+const uint SCAN_BLOCK_SIZE = SCAN_WORKGROUP_SIZE * SCAN_ITEMS_PER_THREAD;
+
+// Nonzero to scan 1 for every nonzero input instead of the input itself; set from the
+// scanFlags GpuScan is created with
+layout (constant_id = 0) const uint SCAN_FLAGS = 0u;
+
+layout (std430, set = 0, binding = 0) readonly buffer Input {
+	uint inputValues[];
+};
+
+// count + 1 values: the exclusive sums followed by the total
+layout (std430, set = 0, binding = 1) writeonly buffer Output {
+	uint outputValues[];
+};
+
+// Total of each block, replaced with their exclusive prefix sum by scan_block_sums.comp
+layout (std430, set = 0, binding = 2) buffer BlockSums {
+	uint blockSums[];
+};
+
+layout (push_constant) uniform Push {
+	uint count;
+	uint blockCount;
+} push;
+
+shared uint threadTotals[SCAN_WORKGROUP_SIZE];
+
+uint loadInput(uint i) {
+	return SCAN_FLAGS != 0u ? min(inputValues[i], 1u) : inputValues[i];
+}
+
+// Inclusive Hillis-Steele scan of threadTotals. Must be reached by the whole workgroup after
+// every thread has written its total
+void scanThreadTotals(uint thread) {
+	barrier();
+	for (uint offset = 1u; offset < SCAN_WORKGROUP_SIZE; offset <<= 1u) {
+		uint addend = thread >= offset ? threadTotals[thread - offset] : 0u;
+		barrier();
+		threadTotals[thread] += addend;
+		barrier();
+	}
+}
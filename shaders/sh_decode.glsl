@@ -0,0 +1,77 @@
+// Reads SH coefficients from the per-model set in the precision chosen by ShPrecision.
+// The including shader provides shPrecision (usually from push constants).
+
+const uint SH_PRECISION_FLOAT32 = 0;
+const uint SH_PRECISION_FLOAT16 = 1;
+const uint SH_PRECISION_UINT8 = 2;
+const uint SH_PRECISION_CODEBOOK = 3;
+
+// Highest SH band stored for the scene, set per pipeline so lower degrees compile out the
+// missing bands. Must match GaussianModel::getShDegree()
+layout (constant_id = 0) const uint SH_DEGREE = 3;
+
+const uint SH_BASIS_COUNT = (SH_DEGREE + 1u) * (SH_DEGREE + 1u);
+const uint SH_COEFFICIENT_COUNT = 3u * SH_BASIS_COUNT;
+const uint SH_REST_COEFFICIENT_COUNT = SH_COEFFICIENT_COUNT - 3u;
+// Quantization blocks are always laid out for degree 3
+const uint SH_MAX_COEFFICIENT_COUNT = 48;
+const uint SH_QUANTIZATION_BLOCK_SIZE = 256;
+
+// Packed strides in words, padded like ShPacker::getPackedStride
+const uint SH_FLOAT16_WORDS = (SH_COEFFICIENT_COUNT + 1u) / 2u;
+const uint SH_UINT8_WORDS = (SH_COEFFICIENT_COUNT + 3u) / 4u;
+
+layout (std430, set = 1, binding = 1) readonly buffer PackedSphericalHarmonics {
+	uint shData[];
+};
+
+// Per block: 48 offsets followed by 48 scales
+layout (std430, set = 1, binding = 2) readonly buffer ShQuantization {
+	float shBlocks[];
+};
+
+// Higher-order SH vectors, SH_REST_COEFFICIENT_COUNT floats per entry
+layout (std430, set = 1, binding = 3) readonly buffer ShCodebook {
+	float shCodebook[];
+};
+
+// Coefficient i of splat, in PLY order (f_dc_0..2, then the f_rest_ coefficients)
+float shValue(uint precision, uint splat, uint i) {
+	if (precision == SH_PRECISION_FLOAT16) {
+		vec2 pair = unpackHalf2x16(shData[splat * SH_FLOAT16_WORDS + i / 2u]);
+		return (i & 1u) == 0u ? pair.x : pair.y;
+	}
+
+	if (precision == SH_PRECISION_UINT8) {
+		uint word = shData[splat * SH_UINT8_WORDS + i / 4u];
+		float q = float((word >> (8u * (i & 3u))) & 0xffu) / 255.0;
+		uint block = (splat / SH_QUANTIZATION_BLOCK_SIZE) * (SH_MAX_COEFFICIENT_COUNT * 2u);
+		return shBlocks[block + i] + q * shBlocks[block + SH_MAX_COEFFICIENT_COUNT + i];
+	}
+
+	if (precision == SH_PRECISION_CODEBOOK) {
+		// Word 0: half2(dc.r, dc.g). Word 1: half dc.b in the low bits, entry index in the high
+		uint word = shData[splat * 2u + (i >= 2u ? 1u : 0u)];
+		if (i < 3u) {
+			vec2 pair = unpackHalf2x16(word);
+			return i == 1u ? pair.y : pair.x;
+		}
+		uint entry = word >> 16;
+		return shCodebook[entry * SH_REST_COEFFICIENT_COUNT + (i - 3u)];
+	}
+
+	return uintBitsToFloat(shData[splat * SH_COEFFICIENT_COUNT + i]);
+}
+
+// RGB of SH basis function k (0..SH_BASIS_COUNT - 1). The PLY stores f_rest channel-major
+vec3 shCoefficient(uint precision, uint splat, uint k) {
+	if (k == 0u) {
+		return vec3(shValue(precision, splat, 0u), shValue(precision, splat, 1u), shValue(precision, splat, 2u));
+	}
+	uint channelStride = SH_BASIS_COUNT - 1u;
+	uint rest = 3u + (k - 1u);
+	return vec3(
+		shValue(precision, splat, rest),
+		shValue(precision, splat, rest + channelStride),
+		shValue(precision, splat, rest + 2u * channelStride));
+}
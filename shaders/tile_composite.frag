@@ -0,0 +1,12 @@
+#version 450
+
+// Reads the tile rasterizer's premultiplied output at the same pixel; blended with
+// ONE, ONE_MINUS_SRC_ALPHA over whatever the swap chain pass drew before it
+
+layout (set = 0, binding = 0, rgba16f) uniform readonly image2D tileImage;
+
+layout (location = 0) out vec4 outColor;
+
+void main() {
+	outColor = imageLoad(tileImage, ivec2(gl_FragCoord.xy));
+}
@@ -0,0 +1,49 @@
+// Declarations shared by the tile rasterizer passes (GaussianTileRasterizer in
+// src/systems/gaussian_render/tile_rasterizer.hpp). Constants must match the class.
+
+#include "projected_splat.glsl"
+
+// Tiles are TILE_SIZE x TILE_SIZE pixels, rendered by one workgroup with a thread per pixel
+const uint TILE_SIZE = 16u;
+
+layout (std430, set = 0, binding = 0) readonly buffer ProjectedSplats {
+	ProjectedSplat projectedSplats[];
+};
+
+// One (view depth, tile) pair per splat and overlapped tile, sorted as a 64-bit key so that
+// each tile's instances are contiguous and front to back
+layout (std430, set = 0, binding = 1) buffer InstanceKeys {
+	uint instanceKeys[];
+};
+
+layout (std430, set = 0, binding = 2) buffer InstanceSplats {
+	uint instanceSplats[];
+};
+
+// Instances requested by tile_duplicate.comp; may exceed the capacity, which drops the rest
+layout (std430, set = 0, binding = 3) buffer InstanceCount {
+	uint instanceCount;
+};
+
+// First and one-past-last sorted instance of each tile, zero for empty tiles
+layout (std430, set = 0, binding = 4) buffer TileRanges {
+	uvec2 tileRanges[];
+};
+
+// Premultiplied color and coverage of all splats drawn so far this frame
+layout (set = 0, binding = 5, rgba16f) uniform image2D tileImage;
+
+layout (push_constant) uniform Push {
+	uvec2 tileCount;
+	uvec2 viewport;
+	uint splatCount;
+	uint instanceCapacity;
+} push;
+
+uint storedInstanceCount() {
+	return min(instanceCount, push.instanceCapacity);
+}
+
+uint instanceTile(uint instance) {
+	return instanceKeys[instance * 2u + 1u];
+}
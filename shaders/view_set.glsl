@@ -0,0 +1,53 @@
+// Per-view set (set 2) of the gaussian pipelines: preprocess.comp's outputs for one model.
+// Bindings must match GaussianRenderSystem::createViewSetLayout
+
+#include "projected_splat.glsl"
+
+layout (std430, set = 2, binding = 0) buffer ProjectedSplats {
+	ProjectedSplat projectedSplats[];
+};
+
+// Back-to-front sort keys of the visible splats, written by compact_scatter.comp
+layout (std430, set = 2, binding = 1) buffer DepthKeys {
+	uint depthKeys[];
+};
+
+// Indices of the visible splats, in splat order after compact_scatter.comp and in draw order
+// once GpuRadixSort has sorted them by depthKeys
+layout (std430, set = 2, binding = 2) buffer SortedSplats {
+	uint sortedSplats[];
+};
+
+// Visible splats per preprocess workgroup, replaced by their exclusive prefix sum in
+// compact_scan.comp
+layout (std430, set = 2, binding = 3) buffer VisibleOffsets {
+	uint visibleOffsets[];
+};
+
+// VkDrawIndirectCommand for the splat draw: a quad instance per visible splat
+layout (std430, set = 2, binding = 4) buffer DrawCommand {
+	uint drawVertexCount;
+	uint drawInstanceCount;
+	uint drawFirstVertex;
+	uint drawFirstInstance;
+};
+
+// Number of visible splats, read by GpuRadixSort::sortIndirect
+layout (std430, set = 2, binding = 5) buffer VisibleCount {
+	uint visibleCount;
+};
+
+// GaussianSortMode::Incremental only: every splat, kept in back-to-front order across frames
+// (the same buffers in each frame's set). Keys at binding 6 are written for a full sort
+layout (std430, set = 2, binding = 6) buffer DepthOrderKeys {
+	uint depthOrderKeys[];
+};
+
+layout (std430, set = 2, binding = 7) buffer DepthOrder {
+	uint depthOrder[];
+};
+
+// Whether the splat at each position of depthOrder is visible this frame, for GpuCompact
+layout (std430, set = 2, binding = 8) buffer DepthOrderVisible {
+	uint depthOrderVisible[];
+};
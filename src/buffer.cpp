@@ -35,7 +35,8 @@ namespace vr {
         uint32_t instanceCount,
         VkBufferUsageFlags usageFlags,
         VkMemoryPropertyFlags memoryPropertyFlags,
-        VkDeviceSize minOffsetAlignment)
+        VkDeviceSize minOffsetAlignment,
+        AllocationStrategy allocationStrategy)
         : vrDevice{ device },
         instanceSize{ instanceSize },
         instanceCount{ instanceCount },
@@ -43,18 +44,20 @@ namespace vr {
         memoryPropertyFlags{ memoryPropertyFlags } {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory, allocationStrategy);
     }
 
     Buffer::~Buffer() {
         unmap();
         vkDestroyBuffer(vrDevice.device(), buffer, nullptr);
-        vkFreeMemory(vrDevice.device(), memory, nullptr);
+        vrDevice.allocator().free(memory);
     }
 
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
      *
+     * @note Host-visible memory stays mapped by the allocator, so this only points into that mapping
+     *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
      * @param offset (Optional) Byte offset from beginning
@@ -62,20 +65,21 @@ namespace vr {
      * @return VkResult of the buffer mapping call
      */
     VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(vrDevice.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && memory.memory && "Called map on buffer before create");
+        if (!memory.mapped) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        mapped = static_cast<char*>(memory.mapped) + offset;
+        return VK_SUCCESS;
     }
 
     /**
      * Unmap a mapped memory range
      *
-     * @note Does not return a result as vkUnmapMemory can't fail
+     * @note The allocator's mapping of the block stays in place for the other buffers in it
      */
     void Buffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(vrDevice.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     /**
@@ -114,9 +118,11 @@ namespace vr {
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
         VkMappedMemoryRange mappedRange = {};
         mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
+        mappedRange.memory = memory.memory;
+        mappedRange.offset = memory.offset + offset;
+        // Allocations of host-visible memory are padded to nonCoherentAtomSize, so the whole
+        // allocation is a valid range that stays clear of neighbouring buffers
+        mappedRange.size = size == VK_WHOLE_SIZE ? memory.size - offset : size;
         return vkFlushMappedMemoryRanges(vrDevice.device(), 1, &mappedRange);
     }
 
@@ -134,9 +140,11 @@ namespace vr {
     VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
         VkMappedMemoryRange mappedRange = {};
         mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
+        mappedRange.memory = memory.memory;
+        mappedRange.offset = memory.offset + offset;
+        // Allocations of host-visible memory are padded to nonCoherentAtomSize, so the whole
+        // allocation is a valid range that stays clear of neighbouring buffers
+        mappedRange.size = size == VK_WHOLE_SIZE ? memory.size - offset : size;
         return vkInvalidateMappedMemoryRanges(vrDevice.device(), 1, &mappedRange);
     }
 
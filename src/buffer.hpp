@@ -12,7 +12,8 @@ namespace vr {
             uint32_t instanceCount,
             VkBufferUsageFlags usageFlags,
             VkMemoryPropertyFlags memoryPropertyFlags,
-            VkDeviceSize minOffsetAlignment = 1);
+            VkDeviceSize minOffsetAlignment = 1,
+            AllocationStrategy allocationStrategy = AllocationStrategy::FreeList);
         ~Buffer();
 
         Buffer(const Buffer&) = delete;
@@ -32,6 +33,7 @@ namespace vr {
         VkResult invalidateIndex(int index);
 
         VkBuffer getBuffer() const { return buffer; }
+        const MemoryAllocation& getAllocation() const { return memory; }
         void* getMappedMemory() const { return mapped; }
         uint32_t getInstanceCount() const { return instanceCount; }
         VkDeviceSize getInstanceSize() const { return instanceSize; }
@@ -46,7 +48,8 @@ namespace vr {
         VrDevice& vrDevice;
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        // A range of a block shared with other buffers, persistently mapped if host visible
+        MemoryAllocation memory{};
 
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
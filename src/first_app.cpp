@@ -2,6 +2,7 @@
 
 #include "movement_controller.hpp"
 #include "buffer.hpp"
+#include "transfer_manager.hpp"
 #include "camera.hpp"
 #include "systems/simple_render/simple_render.hpp"
 #include "systems/gaussian_render/gaussian_render.hpp"	
@@ -13,21 +14,11 @@
 
 namespace vr {
 
-	struct GlobalUbo {
-		glm::mat4 projectionView{ 1.f };
-		glm::vec3 lightDirection = glm::normalize(glm::vec3{ 1.f, -3.f, -1.f });
-	};
-
-	struct GlobalSsbo {
-		glm::mat3 cov3d{};
-	};
-
 	FirstApp::FirstApp() {
 
 		globalPool = VrDescriptorPool::Builder(vrDevice)
 			.setMaxSets(VrSwapChain::MAX_FRAMES_IN_FLIGHT * 2)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VrSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VrSwapChain::MAX_FRAMES_IN_FLIGHT)
 			.build();
 	}
 
@@ -49,22 +40,8 @@ namespace vr {
 			uboBuffers[i]->map();
 		}
 
-		std::vector<std::unique_ptr<Buffer>> ssboBuffers(VrSwapChain::MAX_FRAMES_IN_FLIGHT);
-
-		for (int i = 0; i < ssboBuffers.size(); i++) {
-			ssboBuffers[i] = std::make_unique<Buffer>(
-				vrDevice,
-				sizeof(GlobalSsbo),
-				1,
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-			);
-			ssboBuffers[i]->map();
-		}
-
 		auto globalSetLayout = VrDescriptorSetLayout::Builder(vrDevice)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
 			.build();
 
 		std::vector<VkDescriptorSet>
@@ -72,10 +49,8 @@ namespace vr {
 
 		for (int i = 0; i < globalDescriptorSets.size(); i++) {
 			auto bufferInfo = uboBuffers[i]->descriptorInfo();
-			auto ssboBufferInfo = ssboBuffers[i]->descriptorInfo();
 			VrDescriptorWriter(*globalSetLayout, *globalPool)
 				.writeBuffer(0, &bufferInfo)
-				.writeBuffer(1, &ssboBufferInfo)
 				.build(globalDescriptorSets[i]);
 		}
 
@@ -89,13 +64,11 @@ namespace vr {
 		"C:/Users/JTSte/Downloads//02880940/02880940-c25fd49b75c12ef86bbb74f0f607cdd.ply",
 		vrDevice, 
 		renderer.getSwapChainRenderPass(),
-			globalSetLayout->getDescriptorSetLayout()
+			globalSetLayout->getDescriptorSetLayout(),
+			GaussianLoadOptions{ PlyLoadMode::MemoryMapped, true, true }
 		};
-		
 
-		gaussians = gaussianRenderSystem.getGaussians();
-
-		loadGameObjects();
+		loadGameObjects(gaussianRenderSystem);
 
 		int bindIdx = 0;
 		int gaussianBindIdx = 1;
@@ -104,6 +77,25 @@ namespace vr {
 
 		auto viewerObject = VrGameObject::createGameObject();
 		KeyboardMovementController cameraController{};
+
+		// Built once; they read the frame being recorded through this
+		const FrameInfo* recordingFrameInfo = nullptr;
+		const std::array<Renderer::SecondaryRecorder, 3> passRecorders{
+			[&](VkCommandBuffer secondaryCommandBuffer) {
+				FrameInfo systemFrameInfo = *recordingFrameInfo;
+				systemFrameInfo.commandBuffer = secondaryCommandBuffer;
+				simpleRenderSystem.renderGameObjects(systemFrameInfo, gameObjects, bindIdx);
+			},
+			[&](VkCommandBuffer secondaryCommandBuffer) {
+				// Also the only recorder of the frame's compute command buffer
+				FrameInfo systemFrameInfo = *recordingFrameInfo;
+				systemFrameInfo.commandBuffer = secondaryCommandBuffer;
+				gaussianRenderSystem.renderGameObjects(systemFrameInfo, gaussianObjects, gaussianBindIdx);
+			},
+			[&](VkCommandBuffer secondaryCommandBuffer) {
+				imGuiManager.renderImGui(secondaryCommandBuffer);
+			}
+		};
 		
 		auto currentTime = std::chrono::high_resolution_clock::now();
 
@@ -120,16 +112,15 @@ namespace vr {
 			float aspect = renderer.getAspectRatio();
 			camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.f);
 
-			auto frameCommandBuffers = renderer.beginFrame();
+			FrameHandles frame = renderer.beginFrame();
 			
-			if (!frameCommandBuffers.empty()) {
+			if (frame) {
+				int frameIndex = frame.frameIndex;
 
-				imGuiManager.Vr_ImGui_CreateFontsTexture();
+				auto commandBuffer = frame.commandBuffer;
+				auto computeCommandBuffer = frame.computeCommandBuffer;
 
-				int frameIndex = renderer.getFrameIndex();
-
-				auto commandBuffer = frameCommandBuffers[0];
-				auto computeCommandBuffer = frameCommandBuffers[1];
+				VkExtent2D extent = renderer.getSwapChainExtent();
 
 				FrameInfo frameInfo{
 					frameIndex,
@@ -137,21 +128,32 @@ namespace vr {
 					commandBuffer,
 					computeCommandBuffer,
 					camera,
-					globalDescriptorSets[frameIndex]
+					globalDescriptorSets[frameIndex],
+					extent
 				};
 
 				GlobalUbo ubo{};
 				ubo.projectionView = camera.getProjection() * camera.getView();
+				ubo.view = camera.getView();
+				ubo.projection = camera.getProjection();
+				ubo.cameraPosition = glm::vec4{ camera.getPosition(), 1.f };
+				ubo.viewport = { static_cast<float>(extent.width), static_cast<float>(extent.height) };
 				uboBuffers[frameIndex]->writeToBuffer(&ubo);
 				uboBuffers[frameIndex]->flush();
 
-				renderer.beginSwapChainRenderPass(commandBuffer);
-				simpleRenderSystem.renderGameObjects(frameInfo, gameObjects, bindIdx);
-				//std::cout << "Render game objects" << std::endl;
-				gaussianRenderSystem.renderGameObjects(frameInfo, gaussianObjects, gaussianBindIdx);
-				//std::cout << "Render gaussian objects" << std::endl;
-				imGuiManager.renderImGui(commandBuffer);
+				// Before any worker records, since a new extent idles the device
+				gaussianRenderSystem.resize(extent);
+				gaussianRenderSystem.uploadStreamedGaussians(frameInfo);
+
+				imGuiManager.newFrame();
+
+				// Each system records its part of the pass into a secondary command buffer on a
+				// worker thread; they are executed in this order
+				recordingFrameInfo = &frameInfo;
+				renderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				renderer.recordSecondaryCommandBuffers(commandBuffer, passRecorders);
 				renderer.endSwapChainRenderPass(commandBuffer);
+				recordingFrameInfo = nullptr;
 				renderer.endFrame();
 			}
 		}
@@ -159,7 +161,7 @@ namespace vr {
 		vkDeviceWaitIdle(vrDevice.device());
 	}
 
-	void FirstApp::loadGameObjects() {
+	void FirstApp::loadGameObjects(GaussianRenderSystem& gaussianRenderSystem) {
 		std::shared_ptr<VrModel> vaseModel =
 			VrModel::createModelFromFile(vrDevice, "../../../src/models/flat_vase.obj");
 		auto flatVase = VrGameObject::createGameObject();
@@ -173,10 +175,13 @@ namespace vr {
 		cube.model = cubeModel;
 		gameObjects.push_back(std::move(cube));
 
-		std::shared_ptr<GaussianModel> gaussianModel = GaussianModel::createModelFromGaussians(vrDevice, gaussians);
+		std::shared_ptr<GaussianModel> gaussianModel = gaussianRenderSystem.createModel();
 		auto gaussian = VrGameObject::createGameObject();
 		gaussian.gaussianModel = gaussianModel;
 		gaussianObjects.push_back(std::move(gaussian));
+
+		// Every model's uploads were batched; one submission and wait covers them all
+		vrDevice.transfers().flush();
 	}
 
 }
\ No newline at end of file
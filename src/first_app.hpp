@@ -11,6 +11,8 @@
 #include <vector>
 
 namespace vr {
+	class GaussianRenderSystem;
+
 	class FirstApp {
 	public:
 		static constexpr int WIDTH = 800;
@@ -27,7 +29,7 @@ namespace vr {
 
 	private:
 
-		void loadGameObjects();
+		void loadGameObjects(GaussianRenderSystem& gaussianRenderSystem);
 
 		VrWindow vrWindow{ WIDTH, HEIGHT, "Hello Vulkan" };
 		VrDevice vrDevice{ vrWindow };
@@ -36,7 +38,6 @@ namespace vr {
 		std::unique_ptr<VrDescriptorPool> globalPool{};
 		std::vector<VrGameObject> gameObjects;
 		std::vector<VrGameObject> gaussianObjects;
-		std::vector<GaussianModel::Gaussian> gaussians;
 
 		ImGuiManager imGuiManager{ vrWindow, vrDevice, renderer };
 	};
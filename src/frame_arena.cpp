@@ -0,0 +1,20 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vr {
+
+	FrameArena::FrameArena(size_t capacity) : memory{ std::make_unique<std::byte[]>(capacity) }, capacity{ capacity } {}
+
+	void* FrameArena::allocate(size_t size, size_t alignment) {
+		size_t begin = (offset + alignment - 1) / alignment * alignment;
+		if (begin + size > capacity) {
+			throw std::runtime_error("Frame arena is out of memory");
+		}
+
+		offset = begin + size;
+		peakBytes = std::max(peakBytes, offset);
+		return memory.get() + begin;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+namespace vr {
+
+	// Linear allocator for scratch memory that lives until its frame slot comes round again.
+	// Allocating bumps an offset into memory reserved up front and reset() releases everything at
+	// once, so the frame loop touches no heap. Nothing is destroyed, hence only trivially
+	// destructible types. Not thread safe.
+	class FrameArena {
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 256 * 1024;
+
+		explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		// Throws when the arena is full
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		// count value-initialized elements
+		template <typename T>
+		std::span<T> allocateArray(size_t count) {
+			static_assert(std::is_trivially_destructible_v<T>, "FrameArena never runs destructors");
+			T* elements = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+			std::uninitialized_value_construct_n(elements, count);
+			return { elements, count };
+		}
+
+		void reset() { offset = 0; }
+
+		size_t getCapacity() const { return capacity; }
+		size_t getUsedBytes() const { return offset; }
+		// Most bytes in use at once since creation, for sizing the capacity
+		size_t getPeakBytes() const { return peakBytes; }
+
+	private:
+		std::unique_ptr<std::byte[]> memory;
+		size_t capacity;
+		size_t offset = 0;
+		size_t peakBytes = 0;
+	};
+}
@@ -26,6 +26,16 @@ namespace vr {
 	};
 	*/
 
+	// std140; must match shaders/global_ubo.glsl
+	struct GlobalUbo {
+		glm::mat4 projectionView{ 1.f };
+		glm::vec4 lightDirection = glm::vec4{ glm::normalize(glm::vec3{ 1.f, -3.f, -1.f }), 0.f };
+		glm::mat4 view{ 1.f };
+		glm::mat4 projection{ 1.f };
+		glm::vec4 cameraPosition{ 0.f };
+		glm::vec2 viewport{ 1.f };
+	};
+
 	struct FrameInfo {
 		int frameIndex;
 		float frameTime;
@@ -33,6 +43,7 @@ namespace vr {
 		VkCommandBuffer computeCommandBuffer;
 		Camera& camera;
 		VkDescriptorSet globalDescriptorSet;
+		VkExtent2D extent;
 		//VrGameObject::Map& gameObjects;
 	};
 }  // namespace lve
\ No newline at end of file
@@ -2,14 +2,32 @@
 
 namespace vr {
 
-    glm::mat4 TransformComponent::mat4() {
+    const glm::mat4& TransformComponent::mat4() {
+        updateMatrices();
+        return cachedMat4;
+    }
+
+    const glm::mat3& TransformComponent::normalMatrix() {
+        updateMatrices();
+        return cachedNormalMatrix;
+    }
+
+    void TransformComponent::updateMatrices() {
+        if (hasMatrices && translation == matrixTranslation && scale == matrixScale && rotation == matrixRotation) {
+            return;
+        }
+        hasMatrices = true;
+        matrixTranslation = translation;
+        matrixScale = scale;
+        matrixRotation = rotation;
+
         const float c3 = glm::cos(rotation.z);
         const float s3 = glm::sin(rotation.z);
         const float c2 = glm::cos(rotation.x);
         const float s2 = glm::sin(rotation.x);
         const float c1 = glm::cos(rotation.y);
         const float s1 = glm::sin(rotation.y);
-        return glm::mat4{
+        cachedMat4 = glm::mat4{
             {
                 scale.x * (c1 * c3 + s1 * s2 * s3),
                 scale.x * (c2 * s3),
@@ -29,18 +47,9 @@ namespace vr {
                 0.0f,
             },
             {translation.x, translation.y, translation.z, 1.0f} };
-    }
 
-    glm::mat3 TransformComponent::normalMatrix() {
-        const float c3 = glm::cos(rotation.z);
-        const float s3 = glm::sin(rotation.z);
-        const float c2 = glm::cos(rotation.x);
-        const float s2 = glm::sin(rotation.x);
-        const float c1 = glm::cos(rotation.y);
-        const float s1 = glm::sin(rotation.y);
         const glm::vec3 invScale = 1.0f / scale;
-
-        return glm::mat3{
+        cachedNormalMatrix = glm::mat3{
             {
                 invScale.x * (c1 * c3 + s1 * s2 * s3),
                 invScale.x * (c2 * s3),
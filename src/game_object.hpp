@@ -17,9 +17,20 @@ namespace vr {
         glm::vec3 scale{ 1.f, 1.f, 1.f };
         glm::vec3 rotation{};
 
-        glm::mat4 mat4();
+        // Both are cached, and only recomputed after translation, scale or rotation change
+        const glm::mat4& mat4();
 
-        glm::mat3 normalMatrix();
+        const glm::mat3& normalMatrix();
+
+    private:
+        void updateMatrices();
+
+        bool hasMatrices = false;
+        glm::vec3 matrixTranslation{};
+        glm::vec3 matrixScale{};
+        glm::vec3 matrixRotation{};
+        glm::mat4 cachedMat4{ 1.f };
+        glm::mat3 cachedNormalMatrix{ 1.f };
     };
 
     struct PointLightComponent {
@@ -1,21 +1,35 @@
 #include "gaussian_model.hpp"
 
+#include "transfer_manager.hpp"
 #include "utils.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
 #include <unordered_map>
 #include <iostream>
 
 namespace vr {
-	GaussianModel::GaussianModel(VrDevice& device, const GaussianModel::Builder& builder) : device{ device } {
-		createVertexBuffers(builder.gaussians);
+	GaussianModel::GaussianModel(VrDevice& device, const GaussianModel::Builder& builder)
+		: device{ device }, shPacker{ builder.shPrecision, builder.shDegree, builder.shCodebook } {
+		createVertexBuffers(builder);
 		createIndexBuffers(builder.indices);
 	}
 
+	GaussianModel::GaussianModel(
+		VrDevice& device,
+		uint32_t capacity,
+		uint32_t shDegree,
+		ShPrecision shPrecision,
+		std::shared_ptr<const ShCodebook> shCodebook)
+		: device{ device }, shPacker{ shPrecision, shDegree, std::move(shCodebook) } {
+		createDeviceBuffers(capacity);
+	}
+
 	GaussianModel::~GaussianModel() {}
 
 	std::unique_ptr<GaussianModel> GaussianModel::createModelFromGaussians(
@@ -26,32 +40,245 @@ namespace vr {
 		return std::make_unique<GaussianModel>(device, builder);
 	}
 
-	void GaussianModel::createVertexBuffers(const std::vector<Gaussian>& vertices) {
-		vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount >= 3 && "Vertex count must be at least 3!");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-		
-		uint32_t vertexSize = sizeof(vertices[0]);
-		Buffer stagingBuffer{
-			device,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	void GaussianModel::SplatData::resize(size_t count) {
+		positions.resize(count);
+		covariances.resize(count);
+		sh.resize(count * shCoefficientCount(shDegree));
+	}
+
+	void GaussianModel::SplatData::copyTo(size_t first, size_t count, const SplatStreams& dst) const {
+		std::memcpy(dst.positions, positions.data() + first, count * sizeof(PositionOpacity));
+		std::memcpy(dst.covariances, covariances.data() + first, count * sizeof(Covariance));
+		const uint32_t coefficientCount = shCoefficientCount(shDegree);
+		assert(dst.shCoefficientCount == coefficientCount && "SH stream has a different degree");
+		std::memcpy(dst.sh, sh.data() + first * coefficientCount, count * coefficientCount * sizeof(float));
+	}
+
+	GaussianModel::Covariance GaussianModel::computeCovariance(const glm::vec3& scale, const glm::vec4& rotation) {
+		const float r = rotation.x;
+		const float x = rotation.y;
+		const float y = rotation.z;
+		const float z = rotation.w;
+
+		const float R[3][3] = {
+			{ 1.f - 2.f * (y * y + z * z), 2.f * (x * y - r * z), 2.f * (x * z + r * y) },
+			{ 2.f * (x * y + r * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - r * x) },
+			{ 2.f * (x * z - r * y), 2.f * (y * z + r * x), 1.f - 2.f * (x * x + y * y) },
 		};
+		const float s2[3] = { scale.x * scale.x, scale.y * scale.y, scale.z * scale.z };
+
+		// Sigma = R * S * S^T * R^T
+		auto sigma = [&](int i, int j) {
+			return R[i][0] * s2[0] * R[j][0] + R[i][1] * s2[1] * R[j][1] + R[i][2] * s2[2] * R[j][2];
+		};
+
+		return Covariance{ { sigma(0, 0), sigma(0, 1), sigma(0, 2), sigma(1, 1), sigma(1, 2), sigma(2, 2) } };
+	}
+
+	void GaussianModel::createVertexBuffers(const GaussianModel::Builder& builder) {
+		uint32_t count = builder.writeGaussians ?
+			builder.gaussianCount : static_cast<uint32_t>(builder.gaussians.size());
+		assert(count >= 3 && "Vertex count must be at least 3!");
+
+		createDeviceBuffers(count);
+		vertexCount = count;
+
+		// Splats are written straight into the device's staging ring one piece at a time, so
+		// staging memory stays bounded whatever the scene size. Each piece's copies are submitted
+		// as soon as they are recorded, so the GPU copies piece N while piece N + 1 is written;
+		// the ring holds two pieces, and only the third waits, for the first's copies
+		const VkDeviceSize positionSize = sizeof(PositionOpacity);
+		const VkDeviceSize covarianceSize = sizeof(Covariance);
+		const VkDeviceSize shSize = shPacker.getPackedStride();
+		const VkDeviceSize alignment = TransferManager::STAGING_ALIGNMENT;
+		// One quantization block per splat overestimates the blocks; pieces hold whole blocks
+		const VkDeviceSize bytesPerSplat = positionSize + covarianceSize + shSize + sizeof(ShQuantizationBlock);
+		const uint32_t pieceSize = static_cast<uint32_t>(
+			(TransferManager::MAX_STAGING_ALLOCATION - 4 * alignment) / bytesPerSplat / SH_QUANTIZATION_BLOCK_SIZE * SH_QUANTIZATION_BLOCK_SIZE);
+
+		// Packed precisions need the fp32 coefficients on the host first
+		const uint32_t shCoefficients = shCoefficientCount(shPacker.getShDegree());
+		const bool packSh = shPacker.getPrecision() != ShPrecision::Float32;
+		std::vector<float> shSource(packSh ? static_cast<size_t>(std::min(pieceSize, count)) * shCoefficients : 0);
+		ShPackingError error{};
+
+		auto alignUp = [alignment](VkDeviceSize size) { return (size + alignment - 1) & ~(alignment - 1); };
+
+		TransferManager& transfers = device.transfers();
+		for (uint32_t first = 0; first < count; first += pieceSize) {
+			const uint32_t pieceCount = std::min(pieceSize, count - first);
+			const uint32_t blockCount = packSh ? shPacker.getBlockCount(pieceCount) : 0;
+
+			// All streams of a piece share one allocation, since another could submit the batch
+			// before these copies are recorded
+			const VkDeviceSize covarianceOffset = alignUp(positionSize * pieceCount);
+			const VkDeviceSize shOffset = covarianceOffset + alignUp(covarianceSize * pieceCount);
+			const VkDeviceSize blockOffset = shOffset + alignUp(shSize * pieceCount);
+			auto piece = transfers.allocateStaging(blockOffset + sizeof(ShQuantizationBlock) * blockCount);
+			auto positionStaging = piece.subrange(0, positionSize * pieceCount);
+			auto covarianceStaging = piece.subrange(covarianceOffset, covarianceSize * pieceCount);
+			auto shStaging = piece.subrange(shOffset, shSize * pieceCount);
+			auto blockStaging = piece.subrange(blockOffset, sizeof(ShQuantizationBlock) * blockCount);
+
+			SplatStreams staging{
+				static_cast<PositionOpacity*>(positionStaging.mapped),
+				static_cast<Covariance*>(covarianceStaging.mapped),
+				packSh ? shSource.data() : static_cast<float*>(shStaging.mapped),
+				shCoefficients,
+			};
+
+			if (builder.writeGaussians) {
+				builder.writeGaussians(first, pieceCount, staging);
+			}
+			else {
+				dispatchShDegree(shPacker.getShDegree(), [&](auto layout) {
+					for (uint32_t i = 0; i < pieceCount; i++) {
+						splitGaussian<decltype(layout)>(builder.gaussians[first + i], staging, i);
+					}
+				});
+			}
+
+			if (packSh) {
+				error.merge(shPacker.pack(
+					shSource.data(),
+					pieceCount,
+					shStaging.mapped,
+					static_cast<ShQuantizationBlock*>(blockStaging.mapped),
+					builder.shPackPool));
+				transfers.copy(
+					blockStaging,
+					shQuantizationBuffer->getBuffer(),
+					sizeof(ShQuantizationBlock) * (first / SH_QUANTIZATION_BLOCK_SIZE));
+			}
+
+			transfers.copy(positionStaging, positionBuffer->getBuffer(), positionSize * first);
+			transfers.copy(covarianceStaging, covarianceBuffer->getBuffer(), covarianceSize * first);
+			transfers.copy(shStaging, shBuffer->getBuffer(), shSize * first);
+			transfers.submit();
+		}
+
+		if (packSh) {
+			printShPackingReport(shPacker, count, error);
+		}
+	}
+
+	void GaussianModel::createDeviceBuffers(uint32_t capacity) {
+		this->capacity = capacity;
+
+		positionBuffer = std::make_unique<Buffer>(
+			device,
+			sizeof(PositionOpacity),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		covarianceBuffer = std::make_unique<Buffer>(
+			device,
+			sizeof(Covariance),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		shBuffer = std::make_unique<Buffer>(
+			device,
+			shPacker.getPackedStride(),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		// Always created so the descriptor set is complete; unread unless the SH are quantized
+		shQuantizationBuffer = std::make_unique<Buffer>(
+			device,
+			sizeof(ShQuantizationBlock),
+			std::max(shPacker.getBlockCount(capacity), 1u),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		createShCodebookBuffer();
+	}
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+	void GaussianModel::createShCodebookBuffer() {
+		const ShCodebook* codebook = shPacker.getCodebook();
+		uint32_t floatCount = codebook ? static_cast<uint32_t>(codebook->getEntries().size()) : 1;
 
-		vertexBuffer = std::make_unique<Buffer>(
+		// Like the quantization blocks, always created so the descriptor set is complete
+		shCodebookBuffer = std::make_unique<Buffer>(
 			device,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			sizeof(float),
+			floatCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 		);
 
-		device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+		if (!codebook) {
+			return;
+		}
+
+		device.transfers().upload(codebook->getEntries().data(), sizeof(float) * floatCount, shCodebookBuffer->getBuffer());
+	}
+
+	void GaussianModel::createDescriptorSet(VrDescriptorSetLayout& setLayout, VrDescriptorPool& pool) {
+		auto covarianceInfo = covarianceBuffer->descriptorInfo();
+		auto shInfo = shBuffer->descriptorInfo();
+		auto shQuantizationInfo = shQuantizationBuffer->descriptorInfo();
+		auto shCodebookInfo = shCodebookBuffer->descriptorInfo();
+		auto positionInfo = positionBuffer->descriptorInfo();
+
+		if (!VrDescriptorWriter(setLayout, pool)
+			.writeBuffer(0, &covarianceInfo)
+			.writeBuffer(1, &shInfo)
+			.writeBuffer(2, &shQuantizationInfo)
+			.writeBuffer(3, &shCodebookInfo)
+			.writeBuffer(4, &positionInfo)
+			.build(descriptorSet)) {
+			throw std::runtime_error("Failed to allocate gaussian model descriptor set");
+		}
+	}
+
+	void GaussianModel::appendFromStaging(VkCommandBuffer commandBuffer, const StagingBuffers& staging, uint32_t count) {
+		assert(vertexCount + count <= capacity && "Appending past the end of a streaming model");
+		assert(vertexCount % SH_QUANTIZATION_BLOCK_SIZE == 0 && "Appends must start on an SH quantization block");
+
+		auto copyStream = [&](VkBuffer srcBuffer, Buffer& dstBuffer, VkDeviceSize instanceSize, VkDeviceSize first, VkDeviceSize copyCount) {
+			VkBufferCopy region{};
+			region.dstOffset = instanceSize * first;
+			region.size = instanceSize * copyCount;
+			vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer.getBuffer(), 1, &region);
+		};
+
+		copyStream(staging.positions, *positionBuffer, sizeof(PositionOpacity), vertexCount, count);
+		copyStream(staging.covariances, *covarianceBuffer, sizeof(Covariance), vertexCount, count);
+		copyStream(staging.sh, *shBuffer, shPacker.getPackedStride(), vertexCount, count);
+
+		uint32_t blockCount = shPacker.getBlockCount(count);
+		if (blockCount > 0) {
+			copyStream(
+				staging.shQuantization,
+				*shQuantizationBuffer,
+				sizeof(ShQuantizationBlock),
+				vertexCount / SH_QUANTIZATION_BLOCK_SIZE,
+				blockCount);
+		}
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		vertexCount += count;
 	}
 
 	void GaussianModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
@@ -65,17 +292,6 @@ namespace vr {
 		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
 		uint32_t indexSize = sizeof(indices[0]);
 
-		Buffer stagingBuffer{
-			device,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
-
 		indexBuffer = std::make_unique<Buffer>(
 			device,
 			indexSize,
@@ -84,59 +300,20 @@ namespace vr {
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 		);
 
-		device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		device.transfers().upload(indices.data(), bufferSize, indexBuffer->getBuffer());
 	}
 
-	void GaussianModel::draw(VkCommandBuffer commandBuffer) {
-		if (hasIndexBuffer) {
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-		}
-		else {
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-		}
+	void GaussianModel::drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawCommandBuffer, VkDeviceSize offset) {
+		// The instance count is the number of visible splats, known only on the GPU. Draw order
+		// comes from the sorted splat indices the vertex shader reads, so the index buffer does
+		// not apply to splats
+		vkCmdDrawIndirect(commandBuffer, drawCommandBuffer, offset, 1, sizeof(VkDrawIndirectCommand));
 	}
 
 	void GaussianModel::bind(VkCommandBuffer commandBuffer, int& bindIdx) {
-		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 1, 1, buffers, offsets);
+		// Splats are read from storage buffers; only an index buffer is bound here
 		if (hasIndexBuffer) {
 			vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 		}
 	}
-
-	std::vector<VkVertexInputBindingDescription> GaussianModel::Gaussian::getBindingDescriptions() {
-		std::vector <VkVertexInputBindingDescription> bindingDescriptions(1);
-		bindingDescriptions[0].binding = 1;
-		bindingDescriptions[0].stride = sizeof(Gaussian);
-		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		return bindingDescriptions;
-	}
-
-	std::vector<VkVertexInputAttributeDescription> GaussianModel::Gaussian::getAttributeDescriptions() {
-		std::vector <VkVertexInputAttributeDescription> attributeDescriptions{};
-
-		attributeDescriptions.push_back({ 4, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Gaussian, position) });
-
-		attributeDescriptions.push_back({ 5, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Gaussian, normal) });
-
-		// SH Coefficients
-		for (uint32_t i = 0; i < 12; ++i) {
-			VkVertexInputAttributeDescription shAttr{};
-			shAttr.location = 6 + i;
-			shAttr.binding = 1;
-			shAttr.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-			shAttr.offset = offsetof(Gaussian, sh) + i * sizeof(glm::vec4);
-			attributeDescriptions.push_back(shAttr);
-		};
-
-		attributeDescriptions.push_back({ 18, 1, VK_FORMAT_R32_SFLOAT, offsetof(Gaussian, opacity) });
-
-		attributeDescriptions.push_back({ 19, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Gaussian, scale) });
-
-		attributeDescriptions.push_back({ 20, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Gaussian, rotation) });
-
-		return attributeDescriptions;
-	};
-}
\ No newline at end of file
+}
@@ -2,37 +2,116 @@
 
 #include "vr_device.hpp"
 #include "buffer.hpp"
+#include "descriptors.hpp"
+#include "sh_packing.hpp"
 
 #include <glm/glm.hpp>
 
+#include <cassert>
+#include <cstring>
+#include <functional>
 #include <memory>
 #include <vector>
 
 namespace vr {
 	class GaussianModel {
 	public:
+		// Each splat is drawn as an instance of a quad triangle strip
+		static constexpr uint32_t SPLAT_QUAD_VERTEX_COUNT = 4;
+
+		// Decoded, activated splat as read from a source file. Only used on the CPU; the model
+		// stores splats split into the streams below
 		struct Gaussian {
 			glm::vec3 position;
-			glm::vec3 normal;
-			float sh[48];
+			// f_dc_0..2 followed by the f_rest_ coefficients in PLY order. Only the first
+			// shCoefficientCount(degree) are used for scenes below the maximum SH degree
+			float sh[SH_COEFFICIENT_COUNT];
 			float opacity;
 			glm::vec3 scale;
 			glm::vec4 rotation;
 
-			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
 			bool operator==(const Gaussian& other) const {
-				return position == other.position && scale == other.scale && normal == other.normal && rotation == other.rotation && opacity == other.opacity;
+				return position == other.position && scale == other.scale && rotation == other.rotation && opacity == other.opacity;
+			}
+		};
+
+		// Hot stream: all that culling, depth keys and sorting need (16 bytes)
+		struct PositionOpacity {
+			glm::vec3 position;
+			float opacity;
+		};
+
+		// Upper triangle of the symmetric 3D covariance: xx, xy, xz, yy, yz, zz
+		struct Covariance {
+			float m[6];
+		};
+
+		// Source buffers for appendFromStaging. sh holds packed SH and shQuantization the matching
+		// ShQuantizationBlocks, both starting at the first appended splat
+		struct StagingBuffers {
+			VkBuffer positions;
+			VkBuffer covariances;
+			VkBuffer sh;
+			VkBuffer shQuantization;
+		};
+
+		// Destination for splats written stream by stream. Every pointer has room for the same count.
+		// sh is the cold stream: shCoefficientCount fp32 coefficients per splat, in the order of
+		// Gaussian::sh, packed to the model's ShPrecision on upload
+		struct SplatStreams {
+			PositionOpacity* positions;
+			Covariance* covariances;
+			float* sh;
+			uint32_t shCoefficientCount;
+
+			SplatStreams offset(size_t first) const {
+				return { positions + first, covariances + first, sh + first * shCoefficientCount, shCoefficientCount };
 			}
 		};
 
+		// Host-side structure-of-arrays storage for splats of one SH degree
+		struct SplatData {
+			explicit SplatData(uint32_t shDegree = MAX_SH_DEGREE) : shDegree{ shDegree } {}
+
+			std::vector<PositionOpacity> positions{};
+			std::vector<Covariance> covariances{};
+			std::vector<float> sh{};
+			uint32_t shDegree;
+
+			void resize(size_t count);
+			size_t size() const { return positions.size(); }
+			SplatStreams streams() { return { positions.data(), covariances.data(), sh.data(), shCoefficientCount(shDegree) }; }
+			void copyTo(size_t first, size_t count, const SplatStreams& dst) const;
+		};
+
 		struct Builder {
 			std::vector<Gaussian> gaussians{};
 			std::vector<uint32_t> indices{};
+
+			// Alternative to gaussians: writes gaussianCount splats straight into mapped staging
+			// memory, so the source data is never copied into an intermediate vector. Called with
+			// consecutive ranges in increasing order; dst holds count splats starting at first
+			uint32_t gaussianCount = 0;
+			std::function<void(size_t first, size_t count, const SplatStreams& dst)> writeGaussians{};
+
+			// Highest SH band present in the source; fewer coefficients are stored and uploaded below 3
+			uint32_t shDegree = MAX_SH_DEGREE;
+			ShPrecision shPrecision = ShPrecision::Float32;
+			// Required for ShPrecision::Codebook
+			std::shared_ptr<const ShCodebook> shCodebook{};
+			// Optional; packs SH across its threads
+			ThreadPool* shPackPool = nullptr;
 		};
 
+		// Uploads go through the device's TransferManager; flush it before the model is first used
 		GaussianModel(VrDevice& device, const GaussianModel::Builder& builder);
+		// Empty model with device storage for capacity splats, filled over time by appendFromStaging
+		GaussianModel(
+			VrDevice& device,
+			uint32_t capacity,
+			uint32_t shDegree = MAX_SH_DEGREE,
+			ShPrecision shPrecision = ShPrecision::Float32,
+			std::shared_ptr<const ShCodebook> shCodebook = nullptr);
 		~GaussianModel();
 
 		GaussianModel(const GaussianModel&) = delete;
@@ -42,20 +121,67 @@ namespace vr {
 			VrDevice& device, const std::vector<Gaussian>& gaussians
 		);
 
+		// Expects an activated scale and a normalized (w, x, y, z) rotation quaternion
+		static Covariance computeCovariance(const glm::vec3& scale, const glm::vec4& rotation);
+		// Writes gaussian into every stream of dst at index. Layout is the ShLayout of dst.sh
+		template <typename Layout>
+		static void splitGaussian(const Gaussian& gaussian, const SplatStreams& dst, size_t index);
+
+		// Allocates and writes this model's set: covariances at binding 0, packed SH at binding 1,
+		// SH quantization blocks at binding 2, the SH codebook at binding 3 and positions with
+		// opacity at binding 4
+		void createDescriptorSet(VrDescriptorSetLayout& setLayout, VrDescriptorPool& pool);
+		VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+
+		VkDescriptorBufferInfo positionDescriptorInfo() { return positionBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo covarianceDescriptorInfo() { return covarianceBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo shDescriptorInfo() { return shBuffer->descriptorInfo(); }
+		uint32_t getGaussianCount() const { return vertexCount; }
+		uint32_t getCapacity() const { return capacity; }
+		uint32_t getShDegree() const { return shPacker.getShDegree(); }
+		const ShPacker& getShPacker() const { return shPacker; }
+
+		// Records copies of count splats from the start of the staging buffers to the end of the
+		// model, and makes them visible to compute dispatches recorded after it in the same
+		// command buffer
+		void appendFromStaging(VkCommandBuffer commandBuffer, const StagingBuffers& staging, uint32_t count);
+
 		void bind(VkCommandBuffer commandBuffer, int& bindIdx);
-		void draw(VkCommandBuffer commandBuffer);
+		// Draws the quad instances described by the VkDrawIndirectCommand at offset in drawCommandBuffer
+		void drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawCommandBuffer, VkDeviceSize offset = 0);
 
 	private:
-		void createVertexBuffers(const std::vector<Gaussian>& gaussians);
+		void createVertexBuffers(const GaussianModel::Builder& builder);
+		void createDeviceBuffers(uint32_t capacity);
+		void createShCodebookBuffer();
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
 
 		VrDevice& device;
-		std::unique_ptr<Buffer> vertexBuffer;
-		uint32_t vertexCount;
+		std::unique_ptr<Buffer> positionBuffer;
+		std::unique_ptr<Buffer> covarianceBuffer;
+		std::unique_ptr<Buffer> shBuffer;
+		std::unique_ptr<Buffer> shQuantizationBuffer;
+		std::unique_ptr<Buffer> shCodebookBuffer;
+		ShPacker shPacker{ ShPrecision::Float32, MAX_SH_DEGREE };
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		uint32_t vertexCount = 0;
+		uint32_t capacity = 0;
 
 		bool hasIndexBuffer = false;
 		std::unique_ptr<Buffer> indexBuffer;
 		uint32_t indexCount;
 	};
 
-}
\ No newline at end of file
+	template <typename Layout>
+	void GaussianModel::splitGaussian(const Gaussian& gaussian, const SplatStreams& dst, size_t index) {
+		assert(dst.shCoefficientCount == Layout::COEFFICIENT_COUNT && "SH stream has a different degree");
+
+		// Written through locals and memcpy since dst is usually write-combined staging memory
+		PositionOpacity positionOpacity{ gaussian.position, gaussian.opacity };
+		Covariance covariance = computeCovariance(gaussian.scale, gaussian.rotation);
+
+		std::memcpy(dst.positions + index, &positionOpacity, sizeof(PositionOpacity));
+		std::memcpy(dst.covariances + index, &covariance, sizeof(Covariance));
+		std::memcpy(dst.sh + index * Layout::COEFFICIENT_COUNT, gaussian.sh, Layout::COEFFICIENT_COUNT * sizeof(float));
+	}
+}
@@ -0,0 +1,167 @@
+#include "gaussian_streamer.hpp"
+
+#include "vr_swap_chain.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace vr {
+
+	GaussianStreamer::GaussianStreamer(
+		VrDevice& device,
+		std::shared_ptr<GaussianModel> model,
+		Source source,
+		ThreadPool* packPool)
+		: vrDevice{ device }, model{ std::move(model) }, source{ std::move(source) }, packPool{ packPool } {
+		const ShPacker& shPacker = this->model->getShPacker();
+
+		auto createStagingBuffer = [this](VkDeviceSize instanceSize, size_t instanceCount) {
+			auto stagingBuffer = std::make_unique<Buffer>(
+				vrDevice,
+				instanceSize,
+				static_cast<uint32_t>(instanceCount),
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			stagingBuffer->map();
+			return stagingBuffer;
+		};
+
+		frameStaging.resize(VrSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& staging : frameStaging) {
+			staging.positions = createStagingBuffer(sizeof(GaussianModel::PositionOpacity), CHUNK_SIZE * CHUNKS_PER_FRAME);
+			staging.covariances = createStagingBuffer(sizeof(GaussianModel::Covariance), CHUNK_SIZE * CHUNKS_PER_FRAME);
+			staging.sh = createStagingBuffer(shPacker.getPackedStride(), CHUNK_SIZE * CHUNKS_PER_FRAME);
+			staging.shQuantization = createStagingBuffer(
+				sizeof(ShQuantizationBlock),
+				std::max<size_t>(shPacker.getBlockCount(CHUNK_SIZE * CHUNKS_PER_FRAME), 1));
+		}
+
+		startTime = std::chrono::high_resolution_clock::now();
+		thread = std::thread([this] { run(); });
+	}
+
+	GaussianStreamer::~GaussianStreamer() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopRequested = true;
+		}
+		chunkConsumed.notify_all();
+		thread.join();
+	}
+
+	void GaussianStreamer::run() {
+		const size_t total = model->getCapacity();
+
+		try {
+			for (size_t first = 0; first < total; first += CHUNK_SIZE) {
+				Chunk chunk;
+				{
+					std::unique_lock<std::mutex> lock{ mutex };
+					chunkConsumed.wait(lock, [this] { return stopRequested || readyChunks.size() < MAX_READY_CHUNKS; });
+					if (stopRequested) {
+						return;
+					}
+					if (!freeChunks.empty()) {
+						chunk = std::move(freeChunks.back());
+						freeChunks.pop_back();
+					}
+				}
+
+				chunk.count = std::min(CHUNK_SIZE, total - first);
+				chunk.data.shDegree = model->getShDegree();
+				chunk.data.resize(CHUNK_SIZE);
+				source(first, chunk.count, chunk.data.streams());
+
+				// Packed here rather than in upload() so codebook searches stay off the render thread
+				const ShPacker& shPacker = model->getShPacker();
+				chunk.packedSh.resize(CHUNK_SIZE * shPacker.getPackedStride());
+				chunk.shBlocks.resize(shPacker.getBlockCount(CHUNK_SIZE));
+				chunk.shError = shPacker.pack(
+					chunk.data.sh.data(),
+					chunk.count,
+					chunk.packedSh.data(),
+					chunk.shBlocks.data(),
+					packPool);
+
+				std::lock_guard<std::mutex> lock{ mutex };
+				readyChunks.push_back(std::move(chunk));
+			}
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock{ mutex };
+			error = std::current_exception();
+		}
+	}
+
+	void GaussianStreamer::upload(VkCommandBuffer commandBuffer, int frameIndex) {
+		if (isComplete()) {
+			return;
+		}
+
+		std::vector<Chunk> chunks;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (error) {
+				std::rethrow_exception(error);
+			}
+			while (!readyChunks.empty() && chunks.size() < CHUNKS_PER_FRAME) {
+				chunks.push_back(std::move(readyChunks.front()));
+				readyChunks.pop_front();
+			}
+		}
+
+		if (chunks.empty()) {
+			return;
+		}
+		chunkConsumed.notify_one();
+
+		FrameStaging& staging = frameStaging[frameIndex];
+		const ShPacker& shPacker = model->getShPacker();
+		auto positionStaging = static_cast<GaussianModel::PositionOpacity*>(staging.positions->getMappedMemory());
+		auto covarianceStaging = static_cast<GaussianModel::Covariance*>(staging.covariances->getMappedMemory());
+		auto shStaging = static_cast<char*>(staging.sh->getMappedMemory());
+		auto shQuantizationStaging = static_cast<ShQuantizationBlock*>(staging.shQuantization->getMappedMemory());
+
+		size_t count = 0;
+		for (const auto& chunk : chunks) {
+			std::memcpy(positionStaging + count, chunk.data.positions.data(), chunk.count * sizeof(GaussianModel::PositionOpacity));
+			std::memcpy(covarianceStaging + count, chunk.data.covariances.data(), chunk.count * sizeof(GaussianModel::Covariance));
+			std::memcpy(shStaging + count * shPacker.getPackedStride(), chunk.packedSh.data(), chunk.count * shPacker.getPackedStride());
+			std::memcpy(
+				shQuantizationStaging + shPacker.getBlockCount(count),
+				chunk.shBlocks.data(),
+				shPacker.getBlockCount(chunk.count) * sizeof(ShQuantizationBlock));
+			shError.merge(chunk.shError);
+			count += chunk.count;
+		}
+
+		const bool firstUpload = model->getGaussianCount() == 0;
+
+		GaussianModel::StagingBuffers stagingBuffers{
+			staging.positions->getBuffer(),
+			staging.covariances->getBuffer(),
+			staging.sh->getBuffer(),
+			staging.shQuantization->getBuffer(),
+		};
+		model->appendFromStaging(commandBuffer, stagingBuffers, static_cast<uint32_t>(count));
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			for (auto& chunk : chunks) {
+				freeChunks.push_back(std::move(chunk));
+			}
+		}
+
+		if (firstUpload || isComplete()) {
+			float seconds = std::chrono::duration<float, std::chrono::seconds::period>(
+				std::chrono::high_resolution_clock::now() - startTime).count();
+			std::cout << (firstUpload ? "First streamed gaussians after " : "Streamed all gaussians after ")
+				<< seconds * 1000.f << " ms (" << model->getGaussianCount() << " gaussians)" << std::endl;
+		}
+
+		if (isComplete()) {
+			printShPackingReport(shPacker, model->getGaussianCount(), shError);
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vr_device.hpp"
+#include "buffer.hpp"
+#include "gaussian_model.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vr {
+
+	// Fills a streaming GaussianModel while frames are being rendered. A background thread
+	// pulls splats from a Source in fixed-size chunks, and upload() moves a bounded number of
+	// ready chunks into the model each frame, so the visible splat count grows as data arrives.
+	class GaussianStreamer {
+	public:
+		// Writes count splats starting at first. Called on the streaming thread in increasing order
+		using Source = std::function<void(size_t first, size_t count, const GaussianModel::SplatStreams& dst)>;
+
+		// Splats produced and uploaded as one unit
+		static constexpr size_t CHUNK_SIZE = 64 * 1024;
+		// Upper bound on chunks copied into the model per frame, which sizes the staging buffers
+		static constexpr size_t CHUNKS_PER_FRAME = 4;
+		// Chunks the streaming thread may decode ahead of the uploads before it waits
+		static constexpr size_t MAX_READY_CHUNKS = 16;
+
+		static_assert(CHUNK_SIZE % SH_QUANTIZATION_BLOCK_SIZE == 0, "Chunks must hold whole SH quantization blocks");
+
+		// packPool is optional and only used from the streaming thread to pack SH
+		GaussianStreamer(
+			VrDevice& device,
+			std::shared_ptr<GaussianModel> model,
+			Source source,
+			ThreadPool* packPool = nullptr);
+		~GaussianStreamer();
+
+		GaussianStreamer(const GaussianStreamer&) = delete;
+		GaussianStreamer& operator=(const GaussianStreamer&) = delete;
+
+		// Records the copies for this frame. Must be called outside a render pass, once
+		// acquireNextImage has waited for graphicsTimeline to reach this slot's previous value,
+		// since it reuses that frame's staging buffers
+		void upload(VkCommandBuffer commandBuffer, int frameIndex);
+
+		bool isComplete() const { return model->getGaussianCount() == model->getCapacity(); }
+
+	private:
+		struct Chunk {
+			GaussianModel::SplatData data;
+			std::vector<uint8_t> packedSh;
+			std::vector<ShQuantizationBlock> shBlocks;
+			ShPackingError shError{};
+			size_t count = 0;
+		};
+
+		struct FrameStaging {
+			std::unique_ptr<Buffer> positions;
+			std::unique_ptr<Buffer> covariances;
+			std::unique_ptr<Buffer> sh;
+			std::unique_ptr<Buffer> shQuantization;
+		};
+
+		void run();
+
+		VrDevice& vrDevice;
+		std::shared_ptr<GaussianModel> model;
+		Source source;
+		ThreadPool* packPool;
+
+		std::vector<FrameStaging> frameStaging;
+
+		std::mutex mutex;
+		std::condition_variable chunkConsumed;
+		std::deque<Chunk> readyChunks;
+		std::vector<Chunk> freeChunks;
+		std::exception_ptr error;
+		ShPackingError shError{};
+		bool stopRequested = false;
+
+		std::chrono::high_resolution_clock::time_point startTime;
+		std::thread thread;
+	};
+}
@@ -53,6 +53,7 @@ namespace vr {
 		info.RenderPass = renderer.getSwapChainRenderPass();
 		info.Device = vrDevice.device();
 		info.PhysicalDevice = vrDevice.getPhysicalDevice();
+		info.PipelineCache = vrDevice.pipelineCache();
 		info.ImageCount = VrSwapChain::MAX_FRAMES_IN_FLIGHT;
 		info.MinImageCount = VrSwapChain::MAX_FRAMES_IN_FLIGHT;
 		info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
@@ -66,7 +67,7 @@ namespace vr {
 		ImGui_ImplVulkan_CreateFontsTexture();
 	}
 
-	void ImGuiManager::renderImGui(VkCommandBuffer commandBuffer) {
+	void ImGuiManager::newFrame() {
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
@@ -74,6 +75,9 @@ namespace vr {
 		ImGui::ShowDemoWindow();
 
 		ImGui::Render();
+	}
+
+	void ImGuiManager::renderImGui(VkCommandBuffer commandBuffer) {
 		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer, 0);
 	}
 }
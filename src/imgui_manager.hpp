@@ -23,6 +23,9 @@ namespace vr {
 
 		bool getImGuiFlag() const { return isImGuiEnabled; }
 		void Vr_ImGui_CreateFontsTexture();
+		// Builds this frame's UI. Polls GLFW, so it must run on the main thread
+		void newFrame();
+		// Records the UI built by newFrame. Safe on any thread
 		void renderImGui(VkCommandBuffer commandBuffer);
 	private:
 
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace vr {
+
+	// Read-only memory mapping of a whole file. The mapping stays valid for the lifetime of
+	// the object, so decoders can read straight from the page cache without an extra copy.
+	class MappedFile {
+	public:
+		explicit MappedFile(const std::string& filepath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* data() const { return mapped; }
+		size_t size() const { return fileSize; }
+
+	private:
+		const char* mapped = nullptr;
+		size_t fileSize = 0;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+}
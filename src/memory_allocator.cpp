@@ -0,0 +1,275 @@
+#include "memory_allocator.hpp"
+
+#include "vr_device.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vr {
+
+	namespace {
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	MemoryAllocator::MemoryAllocator(VrDevice& device) : vrDevice{ device } {
+		vkGetPhysicalDeviceMemoryProperties(vrDevice.getPhysicalDevice(), &memoryProperties);
+		nonCoherentAtomSize = std::max<VkDeviceSize>(vrDevice.properties.limits.nonCoherentAtomSize, 1);
+	}
+
+	MemoryAllocator::~MemoryAllocator() {
+		for (auto& block : blocks) {
+			destroyBlock(*block);
+		}
+	}
+
+	bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+		return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	}
+
+	std::unique_ptr<MemoryBlock> MemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, AllocationStrategy strategy) {
+		auto block = std::make_unique<MemoryBlock>();
+		block->size = size;
+		block->memoryTypeIndex = memoryTypeIndex;
+		block->strategy = strategy;
+		block->freeRanges[0] = size;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		if (vkAllocateMemory(vrDevice.device(), &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate device memory block!");
+		}
+
+		if (isHostVisible(memoryTypeIndex) &&
+			vkMapMemory(vrDevice.device(), block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+			vkFreeMemory(vrDevice.device(), block->memory, nullptr);
+			throw std::runtime_error("failed to map device memory block!");
+		}
+		return block;
+	}
+
+	void MemoryAllocator::destroyBlock(MemoryBlock& block) {
+		if (block.mapped) {
+			vkUnmapMemory(vrDevice.device(), block.memory);
+		}
+		vkFreeMemory(vrDevice.device(), block.memory, nullptr);
+	}
+
+	MemoryAllocation MemoryAllocator::allocate(
+		const VkMemoryRequirements& requirements,
+		VkMemoryPropertyFlags properties,
+		AllocationStrategy strategy) {
+		const uint32_t memoryTypeIndex = vrDevice.findMemoryType(requirements.memoryTypeBits, properties);
+
+		VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+		VkDeviceSize size = requirements.size;
+		if (isHostVisible(memoryTypeIndex)) {
+			alignment = alignUp(alignment, nonCoherentAtomSize);
+			size = alignUp(size, nonCoherentAtomSize);
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		MemoryAllocation allocation{};
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.size = size;
+
+		if (size > DEDICATED_THRESHOLD) {
+			auto block = createBlock(memoryTypeIndex, size, strategy);
+			allocation.memory = block->memory;
+			allocation.mapped = block->mapped;
+			// The block record is only needed while creating it; its memory is freed directly
+			block->mapped = nullptr;
+			dedicatedAllocationCount++;
+			dedicatedBytes += size;
+			return allocation;
+		}
+
+		auto tryAllocate = [&](MemoryBlock& block) -> bool {
+			if (block.memoryTypeIndex != memoryTypeIndex || block.strategy != strategy) {
+				return false;
+			}
+
+			if (strategy == AllocationStrategy::Linear) {
+				VkDeviceSize offset = alignUp(block.linearOffset, alignment);
+				if (offset + size > block.size) {
+					return false;
+				}
+				block.linearOffset = offset + size;
+				allocation.offset = offset;
+			}
+			else {
+				auto range = std::find_if(block.freeRanges.begin(), block.freeRanges.end(), [&](const auto& range) {
+					VkDeviceSize offset = alignUp(range.first, alignment);
+					return offset + size <= range.first + range.second;
+				});
+				if (range == block.freeRanges.end()) {
+					return false;
+				}
+
+				// Split the range around the allocation; the alignment padding stays free
+				VkDeviceSize rangeOffset = range->first;
+				VkDeviceSize rangeEnd = range->first + range->second;
+				VkDeviceSize offset = alignUp(rangeOffset, alignment);
+				block.freeRanges.erase(range);
+				if (offset > rangeOffset) {
+					block.freeRanges[rangeOffset] = offset - rangeOffset;
+				}
+				if (offset + size < rangeEnd) {
+					block.freeRanges[offset + size] = rangeEnd - offset - size;
+				}
+				allocation.offset = offset;
+			}
+
+			block.allocationCount++;
+			block.usedBytes += size;
+			allocation.memory = block.memory;
+			allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+			allocation.block = &block;
+			return true;
+		};
+
+		for (auto& block : blocks) {
+			if (tryAllocate(*block)) {
+				return allocation;
+			}
+		}
+
+		blocks.push_back(createBlock(memoryTypeIndex, BLOCK_SIZE, strategy));
+		if (!tryAllocate(*blocks.back())) {
+			throw std::runtime_error("failed to sub-allocate device memory!");
+		}
+		return allocation;
+	}
+
+	void MemoryAllocator::free(MemoryAllocation& allocation) {
+		if (allocation.memory == VK_NULL_HANDLE) {
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock{ mutex };
+
+		if (!allocation.block) {
+			if (allocation.mapped) {
+				vkUnmapMemory(vrDevice.device(), allocation.memory);
+			}
+			vkFreeMemory(vrDevice.device(), allocation.memory, nullptr);
+			dedicatedAllocationCount--;
+			dedicatedBytes -= allocation.size;
+			allocation = {};
+			return;
+		}
+
+		MemoryBlock& block = *allocation.block;
+		block.allocationCount--;
+		block.usedBytes -= allocation.size;
+
+		if (block.strategy == AllocationStrategy::Linear) {
+			if (block.allocationCount == 0) {
+				block.linearOffset = 0;
+			}
+		}
+		else {
+			// Merge with the free ranges on either side
+			VkDeviceSize offset = allocation.offset;
+			VkDeviceSize size = allocation.size;
+
+			auto next = block.freeRanges.lower_bound(offset);
+			if (next != block.freeRanges.end() && next->first == offset + size) {
+				size += next->second;
+				next = block.freeRanges.erase(next);
+			}
+			if (next != block.freeRanges.begin()) {
+				auto previous = std::prev(next);
+				if (previous->first + previous->second == offset) {
+					offset = previous->first;
+					size += previous->second;
+					block.freeRanges.erase(previous);
+				}
+			}
+			block.freeRanges[offset] = size;
+		}
+		allocation = {};
+
+		if (defragmentationHook && block.strategy == AllocationStrategy::FreeList) {
+			BlockStats stats = getBlockStats(block);
+			if (stats.fragmentedBytes > stats.usedBytes) {
+				// Unlocked so the hook can free and allocate
+				DefragmentationHook hook = defragmentationHook;
+				lock.unlock();
+				hook(stats);
+			}
+		}
+	}
+
+	void MemoryAllocator::releaseEmptyBlocks() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		blocks.erase(
+			std::remove_if(blocks.begin(), blocks.end(), [this](const std::unique_ptr<MemoryBlock>& block) {
+				if (block->allocationCount > 0) {
+					return false;
+				}
+				destroyBlock(*block);
+				return true;
+			}),
+			blocks.end());
+	}
+
+	void MemoryAllocator::setDefragmentationHook(DefragmentationHook hook) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		defragmentationHook = std::move(hook);
+	}
+
+	MemoryAllocator::BlockStats MemoryAllocator::getBlockStats(const MemoryBlock& block) const {
+		BlockStats stats{};
+		stats.memoryTypeIndex = block.memoryTypeIndex;
+		stats.strategy = block.strategy;
+		stats.size = block.size;
+		stats.usedBytes = block.usedBytes;
+		stats.allocationCount = block.allocationCount;
+
+		if (block.strategy == AllocationStrategy::Linear) {
+			// Freed space below the bump offset is unusable until the block empties
+			stats.fragmentedBytes = block.linearOffset - block.usedBytes;
+		}
+		else {
+			VkDeviceSize freeBytes = 0;
+			VkDeviceSize largestRange = 0;
+			for (const auto& range : block.freeRanges) {
+				freeBytes += range.second;
+				largestRange = std::max(largestRange, range.second);
+			}
+			stats.fragmentedBytes = freeBytes - largestRange;
+		}
+		return stats;
+	}
+
+	MemoryAllocator::Stats MemoryAllocator::getStats() {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		Stats stats{};
+		for (const auto& block : blocks) {
+			stats.blockCount++;
+			stats.blockBytes += block->size;
+			stats.allocationCount += block->allocationCount;
+			stats.usedBytes += block->usedBytes;
+		}
+		stats.dedicatedAllocationCount = dedicatedAllocationCount;
+		stats.dedicatedBytes = dedicatedBytes;
+		return stats;
+	}
+
+	std::vector<MemoryAllocator::BlockStats> MemoryAllocator::getBlockStats() {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		std::vector<BlockStats> stats;
+		for (const auto& block : blocks) {
+			stats.push_back(getBlockStats(*block));
+		}
+		return stats;
+	}
+}
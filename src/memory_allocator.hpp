@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vr {
+
+	class VrDevice;
+	struct MemoryBlock;
+
+	enum class AllocationStrategy {
+		// First fit from a free list; freed ranges merge with their neighbours and are reused
+		FreeList,
+		// Bump allocation from blocks of their own. A block's space only comes back once all of
+		// its allocations are freed, which suits resources created and destroyed together
+		Linear
+	};
+
+	// A range of device memory handed out by MemoryAllocator
+	struct MemoryAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		// Start of the range in the block's persistent mapping; null unless host visible
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+
+		// Owning block, or null for a dedicated allocation
+		MemoryBlock* block = nullptr;
+	};
+
+	// Sub-allocates buffer memory from large blocks per memory type, so buffers cost a range in
+	// an existing block rather than a vkAllocateMemory each. Host-visible blocks are mapped once
+	// for their lifetime, since a VkDeviceMemory can only be mapped once at a time. Thread safe.
+	class MemoryAllocator {
+	public:
+		static constexpr VkDeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+		// Larger requests get a dedicated VkDeviceMemory instead of a share of a block
+		static constexpr VkDeviceSize DEDICATED_THRESHOLD = BLOCK_SIZE / 2;
+
+		struct BlockStats {
+			uint32_t memoryTypeIndex;
+			AllocationStrategy strategy;
+			VkDeviceSize size;
+			VkDeviceSize usedBytes;
+			uint32_t allocationCount;
+			// Free bytes outside the largest free range; 0 means all free space is contiguous
+			VkDeviceSize fragmentedBytes;
+		};
+
+		struct Stats {
+			uint32_t blockCount = 0;
+			VkDeviceSize blockBytes = 0;
+			uint32_t allocationCount = 0;
+			VkDeviceSize usedBytes = 0;
+			uint32_t dedicatedAllocationCount = 0;
+			VkDeviceSize dedicatedBytes = 0;
+		};
+
+		// Called after a free leaves a free-list block with more fragmented than used bytes.
+		// Owners of the block's allocations may respond by recreating their resources, which
+		// moves them into compact ranges
+		using DefragmentationHook = std::function<void(const BlockStats& block)>;
+
+		MemoryAllocator(VrDevice& device);
+		~MemoryAllocator();
+
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		MemoryAllocation allocate(
+			const VkMemoryRequirements& requirements,
+			VkMemoryPropertyFlags properties,
+			AllocationStrategy strategy = AllocationStrategy::FreeList);
+		void free(MemoryAllocation& allocation);
+
+		// Returns the memory of blocks without allocations to the driver
+		void releaseEmptyBlocks();
+		void setDefragmentationHook(DefragmentationHook hook);
+
+		Stats getStats();
+		std::vector<BlockStats> getBlockStats();
+
+	private:
+		std::unique_ptr<MemoryBlock> createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, AllocationStrategy strategy);
+		void destroyBlock(MemoryBlock& block);
+		bool isHostVisible(uint32_t memoryTypeIndex) const;
+		BlockStats getBlockStats(const MemoryBlock& block) const;
+
+		VrDevice& vrDevice;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		// Host-visible ranges are padded to this so flushing one never touches its neighbours
+		VkDeviceSize nonCoherentAtomSize;
+
+		std::mutex mutex;
+		std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		uint32_t dedicatedAllocationCount = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		DefragmentationHook defragmentationHook;
+	};
+
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		AllocationStrategy strategy = AllocationStrategy::FreeList;
+		void* mapped = nullptr;
+
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedBytes = 0;
+		// FreeList: free ranges by offset. Linear: everything past linearOffset is free
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+		VkDeviceSize linearOffset = 0;
+	};
+}
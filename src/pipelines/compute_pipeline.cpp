@@ -1,43 +1,70 @@
 #include "compute_pipeline.hpp"
+#include "pipeline_compiler.hpp"
+#include "shader_registry.hpp"
 
 #include <cassert>
+#include <chrono>
+#include <memory>
 #include <stdexcept>
-#include <filesystem>
 #include <iostream>
-#include <fstream>
 
 namespace vr {
-	ComputePipeline::ComputePipeline(VrDevice& device, const std::string& compFilepath, const PipelineConfigInfo& configInfo) : vrDevice{ device } {
-		createComputePipeline(compFilepath, configInfo);
+	void memoryBarrier(
+		VkCommandBuffer commandBuffer,
+		VkPipelineStageFlags srcStageMask,
+		VkAccessFlags srcAccessMask,
+		VkPipelineStageFlags dstStageMask,
+		VkAccessFlags dstAccessMask) {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccessMask;
+		barrier.dstAccessMask = dstAccessMask;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			srcStageMask,
+			dstStageMask,
+			0,
+			1,
+			&barrier,
+			0,
+			nullptr,
+			0,
+			nullptr);
+	}
+
+	void computeBarrier(VkCommandBuffer commandBuffer) {
+		memoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	ComputePipeline::ComputePipeline(VrDevice& device, const std::string& compShader, const PipelineConfigInfo& configInfo)
+		: vrDevice{ device }, pipelineLayout{ configInfo.pipelineLayout } {
+		createComputePipeline(compShader, configInfo);
 	};
 
 	ComputePipeline::~ComputePipeline() {
+		// The shader module is in use until compilation finishes
+		if (pendingPipeline.valid()) {
+			try {
+				getPipeline();
+			}
+			catch (const std::exception&) {
+			}
+		}
 		vkDestroyShaderModule(vrDevice.device(), compShaderModule, nullptr);
 		vkDestroyPipeline(vrDevice.device(), computePipeline, nullptr);
 	};
 
-	std::vector<char> ComputePipeline::readFile(const std::string& filename) {
-		std::ifstream file{ filename, std::ios::ate | std::ios::binary };
-
-		if (!file.is_open()) {
-			throw std::runtime_error("Failed to open file: " + filename);
-		}
-
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-
-		file.close();
-		return buffer;
-	}
-
-	void ComputePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+	void ComputePipeline::createShaderModule(std::span<const uint32_t> code, VkShaderModule* shaderModule) {
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		createInfo.codeSize = code.size_bytes();
+		createInfo.pCode = code.data();
 
 		if (vkCreateShaderModule(vrDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create shader module");
@@ -45,34 +72,95 @@ namespace vr {
 	}
 
 
-	void ComputePipeline::createComputePipeline(const std::string& compFilepath, const PipelineConfigInfo& configInfo) {
-		auto compCode = ComputePipeline::readFile(compFilepath);
+	void ComputePipeline::createComputePipeline(const std::string& compShader, const PipelineConfigInfo& configInfo) {
+		auto compCode = getShaderCode(compShader);
 
 		ComputePipeline::createShaderModule(compCode, &compShaderModule);
 
+		// Everything vkCreateComputePipelines reads is copied, since it runs after this returns
+		struct ComputePipelineState {
+			ComputePipelineState(const PipelineConfigInfo& configInfo) : specialization{ configInfo.specializationInfo } {}
+
+			SpecializationInfoCopy specialization;
+			VkComputePipelineCreateInfo pipelineInfo{};
+		};
+		auto state = std::make_shared<ComputePipelineState>(configInfo);
+
 		VkPipelineShaderStageCreateInfo compShaderStage{};
 		compShaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		compShaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 		compShaderStage.module = compShaderModule;
 		compShaderStage.pName = "main";
+		compShaderStage.pSpecializationInfo = state->specialization.getInfo();
 
-		VkComputePipelineCreateInfo pipelineInfo{};
+		VkComputePipelineCreateInfo& pipelineInfo = state->pipelineInfo;
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 		pipelineInfo.stage = compShaderStage;
 		pipelineInfo.layout = configInfo.pipelineLayout;
 
-		if (vkCreateComputePipelines(
-			vrDevice.device(),
-			VK_NULL_HANDLE,
-			1,
-			&pipelineInfo,
-			nullptr,
-			&computePipeline) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create compute pipeline!");
-		}
+		VrDevice& device = vrDevice;
+		pendingPipeline = vrDevice.pipelines().compile([&device, state] {
+			VkComputePipelineCreateInfo pipelineInfo = state->pipelineInfo;
+
+			VkPipelineCreationFeedbackEXT creationFeedback{};
+			VkPipelineCreationFeedbackEXT stageFeedback{};
+			VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+			feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+			feedbackInfo.pPipelineCreationFeedback = &creationFeedback;
+			feedbackInfo.pipelineStageCreationFeedbackCount = 1;
+			feedbackInfo.pPipelineStageCreationFeedbacks = &stageFeedback;
+			if (device.hasPipelineCreationFeedback()) {
+				pipelineInfo.pNext = &feedbackInfo;
+			}
+
+			VkPipeline computePipeline;
+			auto startTime = std::chrono::high_resolution_clock::now();
+			if (vkCreateComputePipelines(
+				device.device(),
+				device.pipelineCache(),
+				1,
+				&pipelineInfo,
+				nullptr,
+				&computePipeline) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create compute pipeline!");
+			}
+			device.recordPipelineCreation(
+				device.hasPipelineCreationFeedback() ? &creationFeedback : nullptr,
+				std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - startTime).count());
+			return computePipeline;
+		});
 	}
 
 	void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, getPipeline());
+	}
+
+	VkPipeline ComputePipeline::getPipeline() {
+		if (pendingPipeline.valid()) {
+			computePipeline = pendingPipeline.get();
+		}
+		return computePipeline;
+	}
+
+	void ComputePipeline::bindDescriptorSets(VkCommandBuffer commandBuffer, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* descriptorSets) {
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayout,
+			firstSet,
+			setCount,
+			descriptorSets,
+			0,
+			nullptr);
+	}
+
+	void ComputePipeline::dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+		bind(commandBuffer);
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+	}
+
+	void ComputePipeline::dispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) {
+		bind(commandBuffer);
+		vkCmdDispatchIndirect(commandBuffer, buffer, offset);
 	}
 }
\ No newline at end of file
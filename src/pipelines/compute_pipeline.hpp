@@ -3,26 +3,64 @@
 #include "vr_pipeline.hpp"
 
 namespace vr {
+	// Records a global memory barrier between the given stages
+	void memoryBarrier(
+		VkCommandBuffer commandBuffer,
+		VkPipelineStageFlags srcStageMask,
+		VkAccessFlags srcAccessMask,
+		VkPipelineStageFlags dstStageMask,
+		VkAccessFlags dstAccessMask);
+	// Makes compute shader writes recorded so far visible to the compute dispatches that follow
+	void computeBarrier(VkCommandBuffer commandBuffer);
+
 	class ComputePipeline {
 	public:
-		ComputePipeline(VrDevice& device, const std::string& compFilepath, const PipelineConfigInfo& configInfo);
+		// compShader names an embedded shader, e.g. "preprocess.comp"; see shader_registry.hpp.
+		// The pipeline is compiled by the device's PipelineCompiler and waited for on first bind
+		ComputePipeline(VrDevice& device, const std::string& compShader, const PipelineConfigInfo& configInfo);
 		~ComputePipeline();
 
 		ComputePipeline(const ComputePipeline&) = delete;
 		ComputePipeline& operator=(const ComputePipeline&) = delete;
 
+		// Workgroups of groupSize invocations needed to cover count invocations
+		static uint32_t groupCount(uint32_t count, uint32_t groupSize) {
+			return (count + groupSize - 1) / groupSize;
+		}
+
 		void bind(VkCommandBuffer commandBuffer);
+		// Waits for the pipeline to finish compiling. Rethrows a compile failure
+		VkPipeline getPipeline();
+		// Binds setCount sets starting at firstSet of configInfo.pipelineLayout
+		void bindDescriptorSets(VkCommandBuffer commandBuffer, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* descriptorSets);
+		void bindDescriptorSet(VkCommandBuffer commandBuffer, uint32_t set, VkDescriptorSet descriptorSet) {
+			bindDescriptorSets(commandBuffer, set, 1, &descriptorSet);
+		}
+
+		// Pushes data at offset 0 of the layout's push constant range for stageFlags
+		template <typename T>
+		void pushConstants(VkCommandBuffer commandBuffer, const T& data, VkShaderStageFlags stageFlags = VK_SHADER_STAGE_COMPUTE_BIT) {
+			vkCmdPushConstants(commandBuffer, pipelineLayout, stageFlags, 0, sizeof(T), &data);
+		}
+
+		// Binds the pipeline and dispatches; bound sets and push constants must already be recorded
+		void dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+		// As dispatch, with the group counts read from a VkDispatchIndirectCommand in buffer
+		void dispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0);
+
+		VkPipelineLayout getPipelineLayout() const { return pipelineLayout; }
 	private:
 		void createComputePipeline(
-			const std::string& compFilepath,
+			const std::string& compShader,
 			const PipelineConfigInfo& configInfo);
 
-		static std::vector<char> readFile(const std::string& filename);
-
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		void createShaderModule(std::span<const uint32_t> code, VkShaderModule* shaderModule);
 
 		VrDevice& vrDevice;
-		VkPipeline computePipeline;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline computePipeline = VK_NULL_HANDLE;
+		// Valid until the pipeline has been taken from it
+		std::future<VkPipeline> pendingPipeline;
 		VkShaderModule compShaderModule;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "gpu_primitives.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vr {
+
+	namespace {
+		struct ScanPushConstants {
+			uint32_t count;
+			uint32_t blockCount;
+		};
+
+		struct CompactPushConstants {
+			uint32_t count;
+		};
+
+		struct HistogramPushConstants {
+			uint32_t count;
+			uint32_t binCount;
+			uint32_t shift;
+		};
+
+		struct SegmentedReducePushConstants {
+			uint32_t segmentCount;
+		};
+	}
+
+	GpuPrimitive::GpuPrimitive(VrDevice& device, uint32_t maxBindingSets, uint32_t bindingCount, uint32_t pushConstantSize)
+		: vrDevice{ device } {
+		VrDescriptorSetLayout::Builder layoutBuilder{ vrDevice };
+		for (uint32_t binding = 0; binding < bindingCount; binding++) {
+			layoutBuilder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+		}
+		setLayout = layoutBuilder.build();
+
+		pool = VrDescriptorPool::Builder(vrDevice)
+			.setMaxSets(maxBindingSets)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBindingSets * bindingCount)
+			.build();
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
+		VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(vrDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute primitive pipeline layout");
+		}
+	}
+
+	GpuPrimitive::~GpuPrimitive() {
+		vkDestroyPipelineLayout(vrDevice.device(), pipelineLayout, nullptr);
+	}
+
+	std::unique_ptr<ComputePipeline> GpuPrimitive::createPipeline(const std::string& compShader, const VkSpecializationInfo* specializationInfo) {
+		PipelineConfigInfo pipelineConfig{};
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipelineConfig.specializationInfo = specializationInfo;
+		return std::make_unique<ComputePipeline>(vrDevice, compShader, pipelineConfig);
+	}
+
+	VkDescriptorSet GpuPrimitive::writeDescriptorSet(const std::vector<VkDescriptorBufferInfo>& buffers) {
+		VrDescriptorWriter writer{ *setLayout, *pool };
+		for (uint32_t binding = 0; binding < buffers.size(); binding++) {
+			writer.writeBuffer(binding, const_cast<VkDescriptorBufferInfo*>(&buffers[binding]));
+		}
+
+		VkDescriptorSet descriptorSet;
+		if (!writer.build(descriptorSet)) {
+			throw std::runtime_error("Failed to allocate compute primitive descriptor set");
+		}
+		return descriptorSet;
+	}
+
+	std::unique_ptr<Buffer> GpuPrimitive::createStorageBuffer(uint32_t count) {
+		return std::make_unique<Buffer>(
+			vrDevice,
+			sizeof(uint32_t),
+			std::max(count, 1u),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	GpuScan::GpuScan(VrDevice& device, uint32_t maxBindingSets, bool scanFlags)
+		: GpuPrimitive{ device, maxBindingSets, 3, sizeof(ScanPushConstants) } {
+		// constant_id 0 in shaders/scan.glsl
+		SpecializationConstants specialization{ scanFlags ? 1u : 0u };
+		reducePipeline = createPipeline("scan_reduce.comp", specialization.getInfo());
+		blockSumsPipeline = createPipeline("scan_block_sums.comp", specialization.getInfo());
+		blocksPipeline = createPipeline("scan_blocks.comp", specialization.getInfo());
+	}
+
+	std::unique_ptr<GpuScan::Bindings> GpuScan::createBindings(
+		const VkDescriptorBufferInfo& input,
+		const VkDescriptorBufferInfo& output,
+		uint32_t capacity) {
+		auto bindings = std::make_unique<Bindings>();
+		bindings->blockSums = createStorageBuffer(ComputePipeline::groupCount(capacity, BLOCK_SIZE));
+		bindings->capacity = capacity;
+		bindings->descriptorSet = writeDescriptorSet({ input, output, bindings->blockSums->descriptorInfo() });
+		return bindings;
+	}
+
+	void GpuScan::scan(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t count) {
+		if (count > bindings.capacity) {
+			throw std::runtime_error("Scan count exceeds binding capacity");
+		}
+
+		ScanPushConstants push{};
+		push.count = count;
+		push.blockCount = ComputePipeline::groupCount(count, BLOCK_SIZE);
+
+		// The passes share one layout, so the set and push constants stay bound. With no
+		// values only the total is written
+		reducePipeline->bindDescriptorSet(commandBuffer, 0, bindings.descriptorSet);
+		reducePipeline->pushConstants(commandBuffer, push);
+
+		if (push.blockCount > 0) {
+			reducePipeline->dispatch(commandBuffer, push.blockCount);
+			computeBarrier(commandBuffer);
+		}
+
+		blockSumsPipeline->dispatch(commandBuffer, 1);
+		computeBarrier(commandBuffer);
+
+		if (push.blockCount > 0) {
+			blocksPipeline->dispatch(commandBuffer, push.blockCount);
+			computeBarrier(commandBuffer);
+		}
+	}
+
+	GpuCompact::GpuCompact(VrDevice& device, uint32_t maxBindingSets)
+		: GpuPrimitive{ device, maxBindingSets, 5, sizeof(CompactPushConstants) }, flagScan{ device, maxBindingSets, true } {
+		scatterPipeline = createPipeline("stream_compact.comp");
+	}
+
+	std::unique_ptr<GpuCompact::Bindings> GpuCompact::createBindings(
+		const VkDescriptorBufferInfo& values,
+		const VkDescriptorBufferInfo& flags,
+		const VkDescriptorBufferInfo& output,
+		const VkDescriptorBufferInfo& keptCount,
+		uint32_t capacity) {
+		auto bindings = std::make_unique<Bindings>();
+		bindings->offsets = createStorageBuffer(capacity + 1);
+		bindings->capacity = capacity;
+
+		auto offsetsInfo = bindings->offsets->descriptorInfo();
+		bindings->scan = flagScan.createBindings(flags, offsetsInfo, capacity);
+		bindings->descriptorSet = writeDescriptorSet({ values, flags, offsetsInfo, output, keptCount });
+		return bindings;
+	}
+
+	void GpuCompact::compact(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t count) {
+		if (count > bindings.capacity) {
+			throw std::runtime_error("Compaction count exceeds binding capacity");
+		}
+
+		flagScan.scan(commandBuffer, *bindings.scan, count);
+
+		CompactPushConstants push{};
+		push.count = count;
+
+		// At least one workgroup, which writes keptCount
+		scatterPipeline->bindDescriptorSet(commandBuffer, 0, bindings.descriptorSet);
+		scatterPipeline->pushConstants(commandBuffer, push);
+		scatterPipeline->dispatch(commandBuffer, std::max(ComputePipeline::groupCount(count, WORKGROUP_SIZE), 1u));
+		computeBarrier(commandBuffer);
+	}
+
+	GpuHistogram::GpuHistogram(VrDevice& device, uint32_t maxBindingSets)
+		: GpuPrimitive{ device, maxBindingSets, 2, sizeof(HistogramPushConstants) } {
+		histogramPipeline = createPipeline("histogram.comp");
+	}
+
+	std::unique_ptr<GpuHistogram::Bindings> GpuHistogram::createBindings(const VkDescriptorBufferInfo& values, const VkDescriptorBufferInfo& bins) {
+		auto bindings = std::make_unique<Bindings>();
+		bindings->bins = bins;
+		bindings->descriptorSet = writeDescriptorSet({ values, bins });
+		return bindings;
+	}
+
+	void GpuHistogram::histogram(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t count, uint32_t binCount, uint32_t shift) {
+		if (binCount == 0) {
+			return;
+		}
+		if (shift >= 32) {
+			throw std::runtime_error("Histogram shift must be below 32");
+		}
+
+		// Earlier shader access to the bins must finish before they are cleared
+		memoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT);
+		vkCmdFillBuffer(
+			commandBuffer,
+			bindings.bins.buffer,
+			bindings.bins.offset,
+			static_cast<VkDeviceSize>(binCount) * sizeof(uint32_t),
+			0);
+		memoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		if (count == 0) {
+			return;
+		}
+
+		HistogramPushConstants push{};
+		push.count = count;
+		push.binCount = binCount;
+		push.shift = shift;
+
+		histogramPipeline->bindDescriptorSet(commandBuffer, 0, bindings.descriptorSet);
+		histogramPipeline->pushConstants(commandBuffer, push);
+		histogramPipeline->dispatch(commandBuffer, ComputePipeline::groupCount(count, WORKGROUP_SIZE * ITEMS_PER_THREAD));
+		computeBarrier(commandBuffer);
+	}
+
+	GpuSegmentedReduce::GpuSegmentedReduce(VrDevice& device, uint32_t maxBindingSets, ReduceOp op)
+		: GpuPrimitive{ device, maxBindingSets, 3, sizeof(SegmentedReducePushConstants) } {
+		// constant_id 0 in shaders/segmented_reduce.comp
+		SpecializationConstants specialization{ static_cast<uint32_t>(op) };
+		reducePipeline = createPipeline("segmented_reduce.comp", specialization.getInfo());
+	}
+
+	std::unique_ptr<GpuSegmentedReduce::Bindings> GpuSegmentedReduce::createBindings(
+		const VkDescriptorBufferInfo& values,
+		const VkDescriptorBufferInfo& segmentOffsets,
+		const VkDescriptorBufferInfo& results) {
+		auto bindings = std::make_unique<Bindings>();
+		bindings->descriptorSet = writeDescriptorSet({ values, segmentOffsets, results });
+		return bindings;
+	}
+
+	void GpuSegmentedReduce::reduce(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t segmentCount) {
+		if (segmentCount == 0) {
+			return;
+		}
+
+		SegmentedReducePushConstants push{};
+		push.segmentCount = segmentCount;
+
+		reducePipeline->bindDescriptorSet(commandBuffer, 0, bindings.descriptorSet);
+		reducePipeline->pushConstants(commandBuffer, push);
+		reducePipeline->dispatch(commandBuffer, std::min(segmentCount, MAX_WORKGROUP_COUNT));
+		computeBarrier(commandBuffer);
+	}
+}
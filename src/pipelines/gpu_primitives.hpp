@@ -0,0 +1,169 @@
+#pragma once
+
+#include "../vr_device.hpp"
+#include "../buffer.hpp"
+#include "../descriptors.hpp"
+#include "compute_pipeline.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reusable compute building blocks over arrays of uint32_t, next to GpuRadixSort for key/value
+// sorts. Each class records into a caller's command buffer through a Bindings object made once
+// per combination of buffers it runs on. Compute writes to the inputs recorded earlier in the
+// command buffer must already be visible; results are visible to compute dispatches recorded
+// after each call.
+
+namespace vr {
+
+	// Storage buffer set layout, pool and pipeline layout shared by the passes of one primitive
+	class GpuPrimitive {
+	public:
+		GpuPrimitive(const GpuPrimitive&) = delete;
+		GpuPrimitive& operator=(const GpuPrimitive&) = delete;
+
+	protected:
+		// bindingCount storage buffers at bindings 0..bindingCount-1 of set 0, and pushConstantSize
+		// bytes of compute push constants. maxBindingSets is the number of sets that can be written
+		GpuPrimitive(VrDevice& device, uint32_t maxBindingSets, uint32_t bindingCount, uint32_t pushConstantSize);
+		~GpuPrimitive();
+
+		std::unique_ptr<ComputePipeline> createPipeline(const std::string& compShader, const VkSpecializationInfo* specializationInfo = nullptr);
+		// Writes buffers[i] to binding i of a new set
+		VkDescriptorSet writeDescriptorSet(const std::vector<VkDescriptorBufferInfo>& buffers);
+		std::unique_ptr<Buffer> createStorageBuffer(uint32_t count);
+
+		VrDevice& vrDevice;
+		std::unique_ptr<VrDescriptorSetLayout> setLayout;
+		std::unique_ptr<VrDescriptorPool> pool;
+		VkPipelineLayout pipelineLayout;
+	};
+
+	// Exclusive prefix sum. Constants must match shaders/scan.glsl
+	class GpuScan : public GpuPrimitive {
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+		static constexpr uint32_t ITEMS_PER_THREAD = 8;
+		// Values scanned by one workgroup
+		static constexpr uint32_t BLOCK_SIZE = WORKGROUP_SIZE * ITEMS_PER_THREAD;
+
+		struct Bindings {
+			std::unique_ptr<Buffer> blockSums;
+			VkDescriptorSet descriptorSet;
+			uint32_t capacity;
+		};
+
+		// With scanFlags, every nonzero input counts as 1, so the sums are output slots
+		GpuScan(VrDevice& device, uint32_t maxBindingSets, bool scanFlags = false);
+
+		// input holds up to capacity values; output needs room for capacity + 1
+		std::unique_ptr<Bindings> createBindings(const VkDescriptorBufferInfo& input, const VkDescriptorBufferInfo& output, uint32_t capacity);
+
+		// Writes the exclusive prefix sum of the first count input values to output, followed by
+		// their total at output[count]
+		void scan(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t count);
+
+	private:
+		std::unique_ptr<ComputePipeline> reducePipeline;
+		std::unique_ptr<ComputePipeline> blockSumsPipeline;
+		std::unique_ptr<ComputePipeline> blocksPipeline;
+	};
+
+	// Stable stream compaction: keeps the values whose flag is nonzero, in order. Flags may hold
+	// any value; only zero or not matters
+	class GpuCompact : public GpuPrimitive {
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+
+		struct Bindings {
+			// Output slot of each value, scanned from the flags
+			std::unique_ptr<Buffer> offsets;
+			std::unique_ptr<GpuScan::Bindings> scan;
+			VkDescriptorSet descriptorSet;
+			uint32_t capacity;
+		};
+
+		GpuCompact(VrDevice& device, uint32_t maxBindingSets);
+
+		// values and flags hold up to capacity entries, one flag per value. output needs room for
+		// capacity values and keptCount for one
+		std::unique_ptr<Bindings> createBindings(
+			const VkDescriptorBufferInfo& values,
+			const VkDescriptorBufferInfo& flags,
+			const VkDescriptorBufferInfo& output,
+			const VkDescriptorBufferInfo& keptCount,
+			uint32_t capacity);
+
+		// Packs the kept values among the first count to the front of output and writes their
+		// number to keptCount
+		void compact(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t count);
+
+	private:
+		GpuScan flagScan;
+		std::unique_ptr<ComputePipeline> scatterPipeline;
+	};
+
+	// Counts values into bins. Constants must match shaders/histogram.comp
+	class GpuHistogram : public GpuPrimitive {
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+		static constexpr uint32_t ITEMS_PER_THREAD = 16;
+		// Up to this many bins are counted in shared memory and merged once per workgroup;
+		// more go straight to global atomics
+		static constexpr uint32_t SHARED_BIN_COUNT = 2048;
+
+		struct Bindings {
+			VkDescriptorSet descriptorSet;
+			VkDescriptorBufferInfo bins;
+		};
+
+		GpuHistogram(VrDevice& device, uint32_t maxBindingSets);
+
+		// bins is cleared with vkCmdFillBuffer, so its buffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+		std::unique_ptr<Bindings> createBindings(const VkDescriptorBufferInfo& values, const VkDescriptorBufferInfo& bins);
+
+		// Replaces the first binCount bins with the number of the first count values whose
+		// value >> shift selects them. Values past the last bin are not counted; shift is below 32
+		void histogram(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t count, uint32_t binCount, uint32_t shift = 0);
+
+	private:
+		std::unique_ptr<ComputePipeline> histogramPipeline;
+	};
+
+	// Must match REDUCE_OP in shaders/segmented_reduce.comp
+	enum class ReduceOp : uint32_t {
+		Add = 0,
+		Min = 1,
+		Max = 2
+	};
+
+	// Reduces runs of values, one workgroup per segment. Constants must match
+	// shaders/segmented_reduce.comp
+	class GpuSegmentedReduce : public GpuPrimitive {
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+		// Workgroups stride over the segments past this count
+		static constexpr uint32_t MAX_WORKGROUP_COUNT = 65535;
+
+		struct Bindings {
+			VkDescriptorSet descriptorSet;
+		};
+
+		GpuSegmentedReduce(VrDevice& device, uint32_t maxBindingSets, ReduceOp op = ReduceOp::Add);
+
+		// Segment s covers values [segmentOffsets[s], segmentOffsets[s + 1]), the layout GpuScan
+		// writes from per-segment lengths. results needs room for one value per segment
+		std::unique_ptr<Bindings> createBindings(
+			const VkDescriptorBufferInfo& values,
+			const VkDescriptorBufferInfo& segmentOffsets,
+			const VkDescriptorBufferInfo& results);
+
+		// Writes the reduction of each of the first segmentCount segments to results. Empty
+		// segments get the identity of the op
+		void reduce(VkCommandBuffer commandBuffer, const Bindings& bindings, uint32_t segmentCount);
+
+	private:
+		std::unique_ptr<ComputePipeline> reducePipeline;
+	};
+}
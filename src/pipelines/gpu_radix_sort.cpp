@@ -0,0 +1,207 @@
+#include "gpu_radix_sort.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vr {
+
+	namespace {
+		struct RadixSortPushConstants {
+			uint32_t count;
+			uint32_t shift;
+			uint32_t blockCount;
+			uint32_t countFromBuffer;
+		};
+	}
+
+	GpuRadixSort::GpuRadixSort(VrDevice& device, uint32_t maxBufferSets, uint32_t keyWords)
+		: vrDevice{ device }, keyWords{ keyWords } {
+		if (keyWords != 1 && keyWords != 2) {
+			throw std::runtime_error("Radix sort keys must be 32 or 64 bits");
+		}
+		createSetLayout(maxBufferSets);
+		createPipelineLayout();
+		createPipelines();
+	}
+
+	GpuRadixSort::~GpuRadixSort() {
+		vkDestroyPipelineLayout(vrDevice.device(), pipelineLayout, nullptr);
+	}
+
+	void GpuRadixSort::createSetLayout(uint32_t maxBufferSets) {
+		setLayout = VrDescriptorSetLayout::Builder(vrDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		pool = VrDescriptorPool::Builder(vrDevice)
+			.setMaxSets(maxBufferSets * 2)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBufferSets * 2 * 6)
+			.build();
+	}
+
+	void GpuRadixSort::createPipelineLayout() {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(RadixSortPushConstants);
+
+		VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(vrDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create radix sort pipeline layout");
+		}
+	}
+
+	void GpuRadixSort::createPipelines() {
+		// constant_id 0 in shaders/radix_sort.glsl
+		SpecializationConstants specialization{ keyWords };
+
+		PipelineConfigInfo pipelineConfig{};
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipelineConfig.specializationInfo = specialization.getInfo();
+
+		histogramPipeline = std::make_unique<ComputePipeline>(vrDevice, "radix_histogram.comp", pipelineConfig);
+		scanPipeline = std::make_unique<ComputePipeline>(vrDevice, "radix_scan.comp", pipelineConfig);
+		scatterPipeline = std::make_unique<ComputePipeline>(vrDevice, "radix_scatter.comp", pipelineConfig);
+	}
+
+	std::unique_ptr<GpuRadixSort::Buffers> GpuRadixSort::createBuffers(uint32_t capacity) {
+		capacity = std::max(capacity, 1u);
+		const uint32_t blockCount = (capacity + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+		// Transfer usage is for the copy back after an odd number of passes, and for callers
+		// that clear the count
+		auto createStorageBuffer = [this](uint32_t count) {
+			return std::make_unique<Buffer>(
+				vrDevice,
+				sizeof(uint32_t),
+				count,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		};
+
+		auto buffers = std::make_unique<Buffers>();
+		buffers->keys = createStorageBuffer(capacity * keyWords);
+		buffers->values = createStorageBuffer(capacity);
+		buffers->scratchKeys = createStorageBuffer(capacity * keyWords);
+		buffers->scratchValues = createStorageBuffer(capacity);
+		buffers->histograms = createStorageBuffer(blockCount * RADIX_SIZE);
+		buffers->count = createStorageBuffer(1);
+		buffers->capacity = capacity;
+
+		auto keysInfo = buffers->keys->descriptorInfo();
+		auto valuesInfo = buffers->values->descriptorInfo();
+		auto scratchKeysInfo = buffers->scratchKeys->descriptorInfo();
+		auto scratchValuesInfo = buffers->scratchValues->descriptorInfo();
+		auto histogramsInfo = buffers->histograms->descriptorInfo();
+		auto countInfo = buffers->count->descriptorInfo();
+
+		if (!VrDescriptorWriter(*setLayout, *pool)
+			.writeBuffer(0, &keysInfo)
+			.writeBuffer(1, &valuesInfo)
+			.writeBuffer(2, &scratchKeysInfo)
+			.writeBuffer(3, &scratchValuesInfo)
+			.writeBuffer(4, &histogramsInfo)
+			.writeBuffer(5, &countInfo)
+			.build(buffers->descriptorSets[0]) ||
+			!VrDescriptorWriter(*setLayout, *pool)
+			.writeBuffer(0, &scratchKeysInfo)
+			.writeBuffer(1, &scratchValuesInfo)
+			.writeBuffer(2, &keysInfo)
+			.writeBuffer(3, &valuesInfo)
+			.writeBuffer(4, &histogramsInfo)
+			.writeBuffer(5, &countInfo)
+			.build(buffers->descriptorSets[1])) {
+			throw std::runtime_error("Failed to allocate radix sort descriptor sets");
+		}
+
+		return buffers;
+	}
+
+	void GpuRadixSort::sort(VkCommandBuffer commandBuffer, const Buffers& buffers, uint32_t count, uint32_t keyBits) {
+		if (count <= 1) {
+			return;
+		}
+		record(commandBuffer, buffers, count, keyBits, false);
+	}
+
+	void GpuRadixSort::sortIndirect(VkCommandBuffer commandBuffer, const Buffers& buffers, uint32_t maxCount, uint32_t keyBits) {
+		if (maxCount == 0) {
+			return;
+		}
+		record(commandBuffer, buffers, maxCount, keyBits, true);
+	}
+
+	void GpuRadixSort::record(VkCommandBuffer commandBuffer, const Buffers& buffers, uint32_t count, uint32_t keyBits, bool countFromBuffer) {
+		if (count > buffers.capacity) {
+			throw std::runtime_error("Radix sort count exceeds buffer capacity");
+		}
+		if (keyBits == 0) {
+			keyBits = keyWords * 32;
+		}
+		if (keyBits > keyWords * 32) {
+			throw std::runtime_error("Radix sort key bits exceed the key width");
+		}
+
+		const uint32_t passCount = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+
+		RadixSortPushConstants push{};
+		push.count = count;
+		push.blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		push.countFromBuffer = countFromBuffer ? 1 : 0;
+
+		for (uint32_t pass = 0; pass < passCount; pass++) {
+			push.shift = pass * RADIX_BITS;
+
+			// The three pipelines share one layout, so the set and push constants stay bound
+			histogramPipeline->bindDescriptorSet(commandBuffer, 0, buffers.descriptorSets[pass % 2]);
+			histogramPipeline->pushConstants(commandBuffer, push);
+
+			histogramPipeline->dispatch(commandBuffer, push.blockCount);
+			computeBarrier(commandBuffer);
+
+			scanPipeline->dispatch(commandBuffer, 1);
+			computeBarrier(commandBuffer);
+
+			scatterPipeline->dispatch(commandBuffer, push.blockCount);
+			computeBarrier(commandBuffer);
+		}
+
+		if (passCount % 2 == 0) {
+			return;
+		}
+
+		// An odd pass count leaves the result in the scratch buffers. Copying the whole range is
+		// cheaper than running one more pass over a digit no key uses
+		memoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		VkBufferCopy keysCopy{ 0, 0, static_cast<VkDeviceSize>(count) * keyWords * sizeof(uint32_t) };
+		VkBufferCopy valuesCopy{ 0, 0, static_cast<VkDeviceSize>(count) * sizeof(uint32_t) };
+		vkCmdCopyBuffer(commandBuffer, buffers.scratchKeys->getBuffer(), buffers.keys->getBuffer(), 1, &keysCopy);
+		vkCmdCopyBuffer(commandBuffer, buffers.scratchValues->getBuffer(), buffers.values->getBuffer(), 1, &valuesCopy);
+
+		memoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	}
+}
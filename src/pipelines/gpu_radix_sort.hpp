@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../vr_device.hpp"
+#include "../buffer.hpp"
+#include "../descriptors.hpp"
+#include "compute_pipeline.hpp"
+
+#include <memory>
+
+namespace vr {
+	// Sorts 32- or 64-bit keys ascending, carrying a 32-bit value with each, entirely in compute
+	// passes: least significant digit first, with a histogram, scan and stable scatter dispatch per
+	// digit. Constants must match shaders/radix_sort.glsl
+	class GpuRadixSort {
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+		static constexpr uint32_t ROUNDS_PER_BLOCK = 16;
+		// Keys handled by one histogram or scatter workgroup
+		static constexpr uint32_t BLOCK_SIZE = WORKGROUP_SIZE * ROUNDS_PER_BLOCK;
+		static constexpr uint32_t RADIX_BITS = 4;
+		static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+
+		// Keys and values to sort, plus the scratch a sort of up to capacity keys needs. The
+		// caller writes keys (keyWords words each, least significant first) and values and reads
+		// the result from the same buffers
+		struct Buffers {
+			std::unique_ptr<Buffer> keys;
+			std::unique_ptr<Buffer> values;
+			std::unique_ptr<Buffer> scratchKeys;
+			std::unique_ptr<Buffer> scratchValues;
+			std::unique_ptr<Buffer> histograms;
+			// Single uint read by sortIndirect
+			std::unique_ptr<Buffer> count;
+			// [0] reads keys and values and writes the scratch buffers, [1] the other way round
+			VkDescriptorSet descriptorSets[2];
+			uint32_t capacity;
+		};
+
+		// maxBufferSets is the number of Buffers that can be created; keyWords is 1 or 2
+		GpuRadixSort(VrDevice& device, uint32_t maxBufferSets, uint32_t keyWords = 1);
+		~GpuRadixSort();
+
+		GpuRadixSort(const GpuRadixSort&) = delete;
+		GpuRadixSort& operator=(const GpuRadixSort&) = delete;
+
+		std::unique_ptr<Buffers> createBuffers(uint32_t capacity);
+
+		uint32_t getKeyWords() const { return keyWords; }
+
+		// Records a sort of the first count keys and values by their lowest keyBits bits (all of
+		// them by default). Compute writes to them recorded earlier in commandBuffer must already
+		// be made visible; the result is visible to compute dispatches recorded after it
+		void sort(VkCommandBuffer commandBuffer, const Buffers& buffers, uint32_t count, uint32_t keyBits = 0);
+		// As sort, for as many keys as buffers.count holds when the sort runs, up to maxCount.
+		// Dispatches are sized for maxCount; workgroups past the actual count exit early
+		void sortIndirect(VkCommandBuffer commandBuffer, const Buffers& buffers, uint32_t maxCount, uint32_t keyBits = 0);
+
+	private:
+		void record(VkCommandBuffer commandBuffer, const Buffers& buffers, uint32_t count, uint32_t keyBits, bool countFromBuffer);
+		void createSetLayout(uint32_t maxBufferSets);
+		void createPipelineLayout();
+		void createPipelines();
+
+		VrDevice& vrDevice;
+		uint32_t keyWords;
+		std::unique_ptr<VrDescriptorSetLayout> setLayout;
+		std::unique_ptr<VrDescriptorPool> pool;
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<ComputePipeline> histogramPipeline;
+		std::unique_ptr<ComputePipeline> scanPipeline;
+		std::unique_ptr<ComputePipeline> scatterPipeline;
+	};
+}
@@ -0,0 +1,39 @@
+#include "pipeline_compiler.hpp"
+
+#include <memory>
+
+namespace vr {
+
+	PipelineCompiler::PipelineCompiler(uint32_t threadCount) : pool{ threadCount } {}
+
+	std::future<VkPipeline> PipelineCompiler::compile(std::function<VkPipeline()> create) {
+		// ThreadPool tasks must be copyable, which a promise is not
+		auto promise = std::make_shared<std::promise<VkPipeline>>();
+		std::future<VkPipeline> future = promise->get_future();
+
+		pool.submit([promise, create = std::move(create)] {
+			try {
+				promise->set_value(create());
+			}
+			catch (...) {
+				promise->set_exception(std::current_exception());
+			}
+		});
+		return future;
+	}
+
+	SpecializationInfoCopy::SpecializationInfoCopy(const VkSpecializationInfo* source) : hasInfo{ source != nullptr } {
+		if (!source) {
+			return;
+		}
+
+		mapEntries.assign(source->pMapEntries, source->pMapEntries + source->mapEntryCount);
+		const char* sourceData = static_cast<const char*>(source->pData);
+		data.assign(sourceData, sourceData + source->dataSize);
+
+		specializationInfo.mapEntryCount = source->mapEntryCount;
+		specializationInfo.pMapEntries = mapEntries.data();
+		specializationInfo.dataSize = source->dataSize;
+		specializationInfo.pData = data.data();
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../thread_pool.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <vector>
+
+namespace vr {
+
+	// Creates pipelines on worker threads. VrPipeline and ComputePipeline hand their create info
+	// over when constructed and only wait for the pipeline when first bound, so everything a
+	// renderer creates at startup compiles concurrently instead of one pipeline after another.
+	// vkCreate*Pipelines and the device's pipeline cache may be used from several threads at once.
+	class PipelineCompiler {
+	public:
+		explicit PipelineCompiler(uint32_t threadCount = std::thread::hardware_concurrency());
+
+		PipelineCompiler(const PipelineCompiler&) = delete;
+		PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+		// Runs create on a worker. The future holds its pipeline, or rethrows what it threw.
+		// Everything create reads must stay alive until the future is ready
+		std::future<VkPipeline> compile(std::function<VkPipeline()> create);
+
+	private:
+		ThreadPool pool;
+	};
+
+	// A VkSpecializationInfo together with the map entries and data it points to, for create
+	// info that outlives the caller's
+	class SpecializationInfoCopy {
+	public:
+		explicit SpecializationInfoCopy(const VkSpecializationInfo* source);
+
+		SpecializationInfoCopy(const SpecializationInfoCopy&) = delete;
+		SpecializationInfoCopy& operator=(const SpecializationInfoCopy&) = delete;
+
+		// Null when the source was
+		const VkSpecializationInfo* getInfo() const { return hasInfo ? &specializationInfo : nullptr; }
+
+	private:
+		bool hasInfo;
+		std::vector<VkSpecializationMapEntry> mapEntries;
+		std::vector<char> data;
+		VkSpecializationInfo specializationInfo{};
+	};
+}
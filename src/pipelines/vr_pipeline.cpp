@@ -1,52 +1,55 @@
 #include "vr_pipeline.hpp"
 
 #include "vr_model.hpp"
+#include "pipeline_compiler.hpp"
+#include "shader_registry.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <chrono>
 #include <stdexcept>
-#include <filesystem>
 #include <cassert>
+#include <memory>
 
 namespace vr {
 
+	SpecializationConstants::SpecializationConstants(std::initializer_list<uint32_t> constants) : values{ constants } {
+		for (uint32_t id = 0; id < values.size(); id++) {
+			mapEntries.push_back({ id, id * static_cast<uint32_t>(sizeof(uint32_t)), sizeof(uint32_t) });
+		}
+
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+		specializationInfo.pMapEntries = mapEntries.data();
+		specializationInfo.dataSize = values.size() * sizeof(uint32_t);
+		specializationInfo.pData = values.data();
+	}
+
 	VrPipeline::VrPipeline(
 		VrDevice& device,
-		const std::string& vertFilepath,
-		const std::string& fragFilepath,
+		const std::string& vertShader,
+		const std::string& fragShader,
 		const PipelineConfigInfo& configInfo, 
 		const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
 		const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions
 	) : vrDevice{ device } {
-		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo, bindingDescriptions, attributeDescriptions);
+		createGraphicsPipeline(vertShader, fragShader, configInfo, bindingDescriptions, attributeDescriptions);
 	}
 
 	VrPipeline::~VrPipeline() {
+		// The shader modules are in use until compilation finishes
+		if (pendingPipeline.valid()) {
+			try {
+				getPipeline();
+			}
+			catch (const std::exception&) {
+			}
+		}
 		vkDestroyShaderModule(vrDevice.device(), vertShaderModule, nullptr);
 		vkDestroyShaderModule(vrDevice.device(), fragShaderModule, nullptr);
 		vkDestroyPipeline(vrDevice.device(), graphicsPipeline, nullptr);
 	}
 
 
-	std::vector<char> VrPipeline::readFile(const std::string& filename) {
-		std::ifstream file{filename, std::ios::ate | std::ios::binary};
-
-		if (!file.is_open()) {
-			throw std::runtime_error("Failed to open file: " + filename);
-		}
-
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-
-		file.close();
-		return buffer;
-	}
-
 	void VrPipeline::createGraphicsPipeline(
-		const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo, const std::vector<VkVertexInputBindingDescription>& bindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions
+		const std::string& vertShader, const std::string& fragShader, const PipelineConfigInfo& configInfo, const std::vector<VkVertexInputBindingDescription>& bindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions
 	) {
 
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
@@ -57,18 +60,36 @@ namespace vr {
 			"Cannot create graphics pipeline:: no renderPass provided in configInfo"
 		);
 
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
+		auto vertCode = getShaderCode(vertShader);
+		auto fragCode = getShaderCode(fragShader);
 
 		createShaderModule(vertCode, &vertShaderModule);
 		createShaderModule(fragCode, &fragShaderModule);
 
-		std::cout << "Vert shader code size " << vertCode.size() << "\n";
-		std::cout << "Frag shader code size " << fragCode.size() << "\n";
-
-		//std::cout << "Current working directory: " << std::filesystem::current_path() << std::endl;
+		// Everything vkCreateGraphicsPipelines reads is copied, since it runs after this returns
+		struct GraphicsPipelineState {
+			GraphicsPipelineState(const PipelineConfigInfo& configInfo) : config{ configInfo }, specialization{ configInfo.specializationInfo } {}
+
+			PipelineConfigInfo config;
+			SpecializationInfoCopy specialization;
+			std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+			VkPipelineShaderStageCreateInfo shaderStages[2];
+		};
+		auto state = std::make_shared<GraphicsPipelineState>(configInfo);
+		state->bindingDescriptions = bindingDescriptions;
+		state->attributeDescriptions = attributeDescriptions;
+
+		// Repoint the config's pointers into itself at the copy
+		PipelineConfigInfo& config = state->config;
+		if (configInfo.colorBlendInfo.pAttachments == &configInfo.colorBlendAttachment) {
+			config.colorBlendInfo.pAttachments = &config.colorBlendAttachment;
+		}
+		if (configInfo.dynamicStateInfo.pDynamicStates == configInfo.dynamicStateEnables.data()) {
+			config.dynamicStateInfo.pDynamicStates = config.dynamicStateEnables.data();
+		}
 
-		VkPipelineShaderStageCreateInfo shaderStages[2];
+		VkPipelineShaderStageCreateInfo* shaderStages = state->shaderStages;
 
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -76,7 +97,7 @@ namespace vr {
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = state->specialization.getInfo();
 
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -84,53 +105,73 @@ namespace vr {
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
-
-		//auto bindingDescriptions = VrModel::Vertex::getBindingDescriptions();
-		//auto attributeDescriptions = VrModel::Vertex::getAttributeDescriptions();
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
-		pipelineInfo.pViewportState = &configInfo.viewportInfo;
-		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
-		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
-		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
-		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
-
-		pipelineInfo.layout = configInfo.pipelineLayout;
-		pipelineInfo.renderPass = configInfo.renderPass;
-		pipelineInfo.subpass = configInfo.subpass;
-
-		pipelineInfo.basePipelineIndex = -1;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-		if (vkCreateGraphicsPipelines(
-				vrDevice.device(),
-				VK_NULL_HANDLE,
-				1,
-				&pipelineInfo,
-				nullptr,
-				&graphicsPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create the graphics pipeline");
-		}
+		shaderStages[1].pSpecializationInfo = state->specialization.getInfo();
+
+		VrDevice& device = vrDevice;
+		pendingPipeline = vrDevice.pipelines().compile([&device, state] {
+			const PipelineConfigInfo& config = state->config;
+
+			VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(state->attributeDescriptions.size());
+			vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(state->bindingDescriptions.size());
+			vertexInputInfo.pVertexAttributeDescriptions = state->attributeDescriptions.data();
+			vertexInputInfo.pVertexBindingDescriptions = state->bindingDescriptions.data();
+
+			VkGraphicsPipelineCreateInfo pipelineInfo{};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineInfo.stageCount = 2;
+			pipelineInfo.pStages = state->shaderStages;
+			pipelineInfo.pVertexInputState = &vertexInputInfo;
+			pipelineInfo.pInputAssemblyState = &config.inputAssemblyInfo;
+			pipelineInfo.pViewportState = &config.viewportInfo;
+			pipelineInfo.pRasterizationState = &config.rasterizationInfo;
+			pipelineInfo.pMultisampleState = &config.multisampleInfo;
+			pipelineInfo.pColorBlendState = &config.colorBlendInfo;
+			pipelineInfo.pDepthStencilState = &config.depthStencilInfo;
+			pipelineInfo.pDynamicState = &config.dynamicStateInfo;
+
+			pipelineInfo.layout = config.pipelineLayout;
+			pipelineInfo.renderPass = config.renderPass;
+			pipelineInfo.subpass = config.subpass;
+
+			pipelineInfo.basePipelineIndex = -1;
+			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+			VkPipelineCreationFeedbackEXT creationFeedback{};
+			VkPipelineCreationFeedbackEXT stageFeedbacks[2]{};
+			VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+			feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+			feedbackInfo.pPipelineCreationFeedback = &creationFeedback;
+			feedbackInfo.pipelineStageCreationFeedbackCount = pipelineInfo.stageCount;
+			feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks;
+			if (device.hasPipelineCreationFeedback()) {
+				pipelineInfo.pNext = &feedbackInfo;
+			}
+
+			VkPipeline graphicsPipeline;
+			auto startTime = std::chrono::high_resolution_clock::now();
+			if (vkCreateGraphicsPipelines(
+					device.device(),
+					device.pipelineCache(),
+					1,
+					&pipelineInfo,
+					nullptr,
+					&graphicsPipeline) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create the graphics pipeline");
+			}
+			device.recordPipelineCreation(
+				device.hasPipelineCreationFeedback() ? &creationFeedback : nullptr,
+				std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - startTime).count());
+			return graphicsPipeline;
+		});
 	}
 
-	void VrPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+	void VrPipeline::createShaderModule(std::span<const uint32_t> code, VkShaderModule* shaderModule) {
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		createInfo.codeSize = code.size_bytes();
+		createInfo.pCode = code.data();
 
 		if (vkCreateShaderModule(vrDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create shader module");
@@ -138,7 +179,14 @@ namespace vr {
 	}
 
 	void VrPipeline::bind(VkCommandBuffer commandBuffer) {
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline());
+	}
+
+	VkPipeline VrPipeline::getPipeline() {
+		if (pendingPipeline.valid()) {
+			graphicsPipeline = pendingPipeline.get();
+		}
+		return graphicsPipeline;
 	}
 
 	void VrPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
@@ -212,4 +260,20 @@ namespace vr {
 		configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 		configInfo.dynamicStateInfo.flags = 0;
 	}
+
+	void VrPipeline::splatPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+		defaultPipelineConfigInfo(configInfo);
+
+		configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+		configInfo.colorBlendAttachment.blendEnable = VK_TRUE;
+		configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		configInfo.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		configInfo.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+		configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+	}
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "../vr_device.hpp"
+#include <future>
+#include <initializer_list>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -20,14 +23,35 @@ namespace vr {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// Specialization constants applied to every shader stage; must outlive pipeline creation
+		const VkSpecializationInfo* specializationInfo = nullptr;
+	};
+
+	// 32-bit specialization constants with ids 0, 1, ... in the order given, for
+	// PipelineConfigInfo::specializationInfo
+	class SpecializationConstants {
+	public:
+		SpecializationConstants(std::initializer_list<uint32_t> constants);
+
+		SpecializationConstants(const SpecializationConstants&) = delete;
+		SpecializationConstants& operator=(const SpecializationConstants&) = delete;
+
+		const VkSpecializationInfo* getInfo() const { return &specializationInfo; }
+
+	private:
+		std::vector<uint32_t> values;
+		std::vector<VkSpecializationMapEntry> mapEntries;
+		VkSpecializationInfo specializationInfo{};
 	};
 
 	class VrPipeline {
 		public:
+			// vertShader and fragShader name embedded shaders, e.g. "simple_shader.vert"; see shader_registry.hpp.
+			// The pipeline is compiled by the device's PipelineCompiler and waited for on first bind
 			VrPipeline(
 				VrDevice& device, 
-				const std::string& vertFilepath, 
-				const std::string& fragFilepath, 
+				const std::string& vertShader, 
+				const std::string& fragShader, 
 				const PipelineConfigInfo& configInfo,
 				const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
 				const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions
@@ -38,24 +62,30 @@ namespace vr {
 			VrPipeline& operator=(const VrPipeline&) = delete;
 
 			void bind(VkCommandBuffer commandBuffer);
+			// Waits for the pipeline to finish compiling. Rethrows a compile failure
+			VkPipeline getPipeline();
 
 			static void defaultPipelineConfigInfo(PipelineConfigInfo &configInfo);
+			// Gaussian splats drawn as one instanced 4-vertex triangle strip each, sorted back to
+			// front: premultiplied-alpha "over" blending, depth tested against opaque geometry
+			// but not written
+			static void splatPipelineConfigInfo(PipelineConfigInfo &configInfo);
 
 		private:
 
 			void createGraphicsPipeline(
-				const std::string& vertFilepath, 
-				const std::string& fragFilepath, 
+				const std::string& vertShader, 
+				const std::string& fragShader, 
 				const PipelineConfigInfo& configInfo, 
 				const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
 				const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
 
-			static std::vector<char> readFile(const std::string& filename);
-
-			void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+			void createShaderModule(std::span<const uint32_t> code, VkShaderModule* shaderModule);
 
 			VrDevice& vrDevice;
-			VkPipeline graphicsPipeline;
+			VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+			// Valid until the pipeline has been taken from it
+			std::future<VkPipeline> pendingPipeline;
 			VkShaderModule vertShaderModule;
 			VkShaderModule fragShaderModule;
 	};
@@ -0,0 +1,247 @@
+#include "ply_decoder.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace vr {
+
+	namespace {
+		constexpr uint32_t FLOATS_PER_GAUSSIAN = sizeof(GaussianModel::Gaussian) / sizeof(float);
+		static_assert(sizeof(GaussianModel::Gaussian) == FLOATS_PER_GAUSSIAN * sizeof(float),
+			"Gaussian must be tightly packed floats to be decoded by index");
+
+		constexpr uint32_t floatIndex(size_t byteOffset) {
+			return static_cast<uint32_t>(byteOffset / sizeof(float));
+		}
+
+		// Parses "<prefix><n>" and returns n, or -1 if name does not match
+		int suffixIndex(const std::string& name, const char* prefix) {
+			size_t prefixLength = std::strlen(prefix);
+			if (name.size() <= prefixLength || name.compare(0, prefixLength, prefix) != 0) {
+				return -1;
+			}
+			int value = 0;
+			for (size_t i = prefixLength; i < name.size(); i++) {
+				if (name[i] < '0' || name[i] > '9') {
+					return -1;
+				}
+				value = value * 10 + (name[i] - '0');
+			}
+			return value;
+		}
+	}
+
+	PlyDecoder::PlyDecoder(const PlyHeader& header, bool applyActivations) {
+		if (header.format == "ascii") {
+			throw std::runtime_error("ASCII PLY files are not supported");
+		}
+		else if (header.format == "binary_big_endian") {
+			swapBytes = std::endian::native == std::endian::little;
+		}
+		else if (header.format == "binary_little_endian") {
+			swapBytes = std::endian::native == std::endian::big;
+		}
+		else {
+			throw std::runtime_error("Unknown PLY format: " + header.format);
+		}
+
+		shDegree = detectShDegree(header);
+
+		std::vector<bool> mapped(FLOATS_PER_GAUSSIAN, false);
+		uint32_t offset = 0;
+
+		for (const auto& property : header.vertexProperties) {
+			ScalarType type = parseScalarType(property.type);
+			int dstIndex = destinationIndex(property.name);
+
+			if (dstIndex >= 0 && !mapped[dstIndex]) {
+				mapped[dstIndex] = true;
+
+				if (type == ScalarType::Float32 && !swapBytes) {
+					if (!runs.empty() &&
+						runs.back().srcOffset + runs.back().count * sizeof(float) == offset &&
+						runs.back().dstIndex + runs.back().count == static_cast<uint32_t>(dstIndex)) {
+						runs.back().count++;
+					}
+					else {
+						runs.push_back({ offset, static_cast<uint32_t>(dstIndex), 1 });
+					}
+				}
+				else {
+					fields.push_back({ offset, static_cast<uint32_t>(dstIndex), type });
+				}
+			}
+
+			offset += scalarSize(type);
+		}
+
+		vertexStride = offset;
+		if (vertexStride == 0) {
+			throw std::runtime_error("PLY file has no vertex properties");
+		}
+
+		// SH slots above the scene's degree are never read, so they need no defaults
+		using Gaussian = GaussianModel::Gaussian;
+		std::fill(
+			mapped.begin() + floatIndex(offsetof(Gaussian, sh)) + shCoefficientCount(shDegree),
+			mapped.begin() + floatIndex(offsetof(Gaussian, sh)) + SH_COEFFICIENT_COUNT,
+			true);
+		completeLayout = std::all_of(mapped.begin(), mapped.end(), [](bool m) { return m; });
+
+		if (applyActivations) {
+			activateOpacity = mapped[floatIndex(offsetof(Gaussian, opacity))];
+			activateScale = mapped[floatIndex(offsetof(Gaussian, scale))];
+			activateRotation = mapped[floatIndex(offsetof(Gaussian, rotation))];
+		}
+	}
+
+	void PlyDecoder::decode(const char* src, size_t count, const GaussianModel::SplatStreams& dst) const {
+		if (dst.shCoefficientCount != shCoefficientCount(shDegree)) {
+			throw std::runtime_error("PLY decode target has a different SH degree");
+		}
+
+		dispatchShDegree(shDegree, [&](auto layout) {
+			decodeSplats<decltype(layout)>(src, count, dst);
+		});
+	}
+
+	template <typename Layout>
+	void PlyDecoder::decodeSplats(const char* src, size_t count, const GaussianModel::SplatStreams& dst) const {
+		GaussianModel::Gaussian defaults{};
+		defaults.rotation = { 1.f, 0.f, 0.f, 0.f };
+
+		// Each splat is assembled on the stack and split into dst once, since dst is usually
+		// write-combined staging memory that is very slow to read back from.
+		GaussianModel::Gaussian gaussian = defaults;
+		float* out = reinterpret_cast<float*>(&gaussian);
+
+		for (size_t i = 0; i < count; i++) {
+			const char* record = src + i * vertexStride;
+
+			if (!completeLayout) {
+				gaussian = defaults;
+			}
+
+			for (const auto& run : runs) {
+				std::memcpy(out + run.dstIndex, record + run.srcOffset, run.count * sizeof(float));
+			}
+
+			for (const auto& field : fields) {
+				out[field.dstIndex] = readScalar(record + field.srcOffset, field.type, swapBytes);
+			}
+
+			if (activateOpacity) {
+				gaussian.opacity = 1.f / (1.f + std::exp(-gaussian.opacity));
+			}
+			if (activateScale) {
+				gaussian.scale = { std::exp(gaussian.scale.x), std::exp(gaussian.scale.y), std::exp(gaussian.scale.z) };
+			}
+			if (activateRotation) {
+				glm::vec4& q = gaussian.rotation;
+				float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+				if (length > 0.f) {
+					q = { q.x / length, q.y / length, q.z / length, q.w / length };
+				}
+				else {
+					q = { 1.f, 0.f, 0.f, 0.f };
+				}
+			}
+
+			GaussianModel::splitGaussian<Layout>(gaussian, dst, i);
+		}
+	}
+
+	uint32_t PlyDecoder::detectShDegree(const PlyHeader& header) {
+		int restCount = 0;
+		for (const auto& property : header.vertexProperties) {
+			restCount = std::max(restCount, suffixIndex(property.name, "f_rest_") + 1);
+		}
+
+		for (uint32_t degree = 0; degree <= MAX_SH_DEGREE; degree++) {
+			if (static_cast<uint32_t>(restCount) == shCoefficientCount(degree) - 3) {
+				return degree;
+			}
+		}
+		throw std::runtime_error("PLY file has " + std::to_string(restCount) + " f_rest_ properties, which matches no SH degree");
+	}
+
+	PlyDecoder::ScalarType PlyDecoder::parseScalarType(const std::string& type) {
+		if (type == "char" || type == "int8") return ScalarType::Int8;
+		if (type == "uchar" || type == "uint8") return ScalarType::UInt8;
+		if (type == "short" || type == "int16") return ScalarType::Int16;
+		if (type == "ushort" || type == "uint16") return ScalarType::UInt16;
+		if (type == "int" || type == "int32") return ScalarType::Int32;
+		if (type == "uint" || type == "uint32") return ScalarType::UInt32;
+		if (type == "float" || type == "float32") return ScalarType::Float32;
+		if (type == "double" || type == "float64") return ScalarType::Float64;
+
+		throw std::runtime_error("Unsupported PLY vertex property type: " + type);
+	}
+
+	uint32_t PlyDecoder::scalarSize(ScalarType type) {
+		switch (type) {
+		case ScalarType::Int8:
+		case ScalarType::UInt8:
+			return 1;
+		case ScalarType::Int16:
+		case ScalarType::UInt16:
+			return 2;
+		case ScalarType::Int32:
+		case ScalarType::UInt32:
+		case ScalarType::Float32:
+			return 4;
+		case ScalarType::Float64:
+			return 8;
+		}
+		return 0;
+	}
+
+	int PlyDecoder::destinationIndex(const std::string& name) {
+		using Gaussian = GaussianModel::Gaussian;
+
+		if (name == "x") return floatIndex(offsetof(Gaussian, position)) + 0;
+		if (name == "y") return floatIndex(offsetof(Gaussian, position)) + 1;
+		if (name == "z") return floatIndex(offsetof(Gaussian, position)) + 2;
+		if (name == "opacity") return floatIndex(offsetof(Gaussian, opacity));
+
+		int index = suffixIndex(name, "f_dc_");
+		if (index >= 0 && index < 3) return floatIndex(offsetof(Gaussian, sh)) + index;
+
+		index = suffixIndex(name, "f_rest_");
+		if (index >= 0 && index < static_cast<int>(SH_COEFFICIENT_COUNT - 3)) return floatIndex(offsetof(Gaussian, sh)) + 3 + index;
+
+		index = suffixIndex(name, "scale_");
+		if (index >= 0 && index < 3) return floatIndex(offsetof(Gaussian, scale)) + index;
+
+		index = suffixIndex(name, "rot_");
+		if (index >= 0 && index < 4) return floatIndex(offsetof(Gaussian, rotation)) + index;
+
+		return -1;
+	}
+
+	float PlyDecoder::readScalar(const char* src, ScalarType type, bool swapBytes) {
+		unsigned char bytes[8];
+		uint32_t size = scalarSize(type);
+		std::memcpy(bytes, src, size);
+		if (swapBytes) {
+			std::reverse(bytes, bytes + size);
+		}
+
+		switch (type) {
+		case ScalarType::Int8: { int8_t v; std::memcpy(&v, bytes, sizeof(v)); return static_cast<float>(v); }
+		case ScalarType::UInt8: { uint8_t v; std::memcpy(&v, bytes, sizeof(v)); return static_cast<float>(v); }
+		case ScalarType::Int16: { int16_t v; std::memcpy(&v, bytes, sizeof(v)); return static_cast<float>(v); }
+		case ScalarType::UInt16: { uint16_t v; std::memcpy(&v, bytes, sizeof(v)); return static_cast<float>(v); }
+		case ScalarType::Int32: { int32_t v; std::memcpy(&v, bytes, sizeof(v)); return static_cast<float>(v); }
+		case ScalarType::UInt32: { uint32_t v; std::memcpy(&v, bytes, sizeof(v)); return static_cast<float>(v); }
+		case ScalarType::Float32: { float v; std::memcpy(&v, bytes, sizeof(v)); return v; }
+		case ScalarType::Float64: { double v; std::memcpy(&v, bytes, sizeof(v)); return static_cast<float>(v); }
+		}
+		return 0.f;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "gaussian_model.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vr {
+
+	struct PlyProperty {
+		std::string type;
+		std::string name;
+	};
+
+	struct PlyHeader {
+		std::string format;
+		int numVertices = 0;
+		int numFaces = 0;
+		std::vector<PlyProperty> vertexProperties;
+		std::vector<PlyProperty> faceProperties;
+	};
+
+	// Decodes the binary vertex body of a Gaussian splat PLY file. The layout of a vertex
+	// record is resolved once from the header's property list, so files with extra or
+	// reordered properties decode into the right GaussianModel::Gaussian fields.
+	//
+	// decode() holds no mutable state, so disjoint ranges can be decoded concurrently.
+	class PlyDecoder {
+	public:
+		// With applyActivations the raw training values are converted on decode:
+		// sigmoid(opacity), exp(scale) and a normalized rotation quaternion.
+		explicit PlyDecoder(const PlyHeader& header, bool applyActivations = true);
+
+		size_t getVertexStride() const { return vertexStride; }
+		// SH degree implied by the number of f_rest_ properties (0, 9, 24 or 45 for degrees 0-3)
+		uint32_t getShDegree() const { return shDegree; }
+
+		// Writes count splats into the streams of dst, including their 3D covariances. dst.sh must
+		// hold shCoefficientCount(getShDegree()) floats per splat. Properties that do not map to a
+		// stream (normals, colors) are skipped.
+		void decode(const char* src, size_t count, const GaussianModel::SplatStreams& dst) const;
+
+	private:
+		enum class ScalarType : uint8_t { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+		struct FieldMapping {
+			uint32_t srcOffset;
+			uint32_t dstIndex;
+			ScalarType type;
+		};
+
+		// A run of consecutive float32 properties that land in consecutive destination floats
+		struct FieldRun {
+			uint32_t srcOffset;
+			uint32_t dstIndex;
+			uint32_t count;
+		};
+
+		static ScalarType parseScalarType(const std::string& type);
+		static uint32_t scalarSize(ScalarType type);
+		static int destinationIndex(const std::string& name);
+		static float readScalar(const char* src, ScalarType type, bool swapBytes);
+		static uint32_t detectShDegree(const PlyHeader& header);
+
+		// decode() for one SH degree, so the per-splat copy is sized at compile time
+		template <typename Layout>
+		void decodeSplats(const char* src, size_t count, const GaussianModel::SplatStreams& dst) const;
+
+		std::vector<FieldMapping> fields;
+		std::vector<FieldRun> runs;
+		size_t vertexStride = 0;
+		uint32_t shDegree = 0;
+		bool swapBytes = false;
+		bool completeLayout = false;
+
+		bool activateOpacity = false;
+		bool activateScale = false;
+		bool activateRotation = false;
+	};
+}
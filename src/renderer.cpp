@@ -18,6 +18,12 @@ namespace vr {
 
 	Renderer::~Renderer() { 
 		freeCommandBuffers(); 
+
+		for (auto& frameCommands : secondaryCommands) {
+			for (auto& commands : frameCommands) {
+				vkDestroyCommandPool(vrDevice.device(), commands.commandPool, nullptr);
+			}
+		}
 	}
 
 	void Renderer::recreateSwapChain() {
@@ -86,16 +92,13 @@ namespace vr {
 		computeCommandBuffers.clear();
 	}
 
-	std::vector<VkCommandBuffer> Renderer::beginFrame() {
+	FrameHandles Renderer::beginFrame() {
 		assert(!isFrameStarted && "Cannot call beginFrame while already in progress");
 
-		frameCommandBuffers.clear();
-
 		auto result = vrSwapChain->acquireNextImage(&currentImageIndex);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
-			frameCommandBuffers[0] = nullptr;
-			return frameCommandBuffers;
+			return {};
 		}
 
 		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
@@ -119,11 +122,10 @@ namespace vr {
 			throw std::runtime_error("Failed to begin recording command buffer");
 		}
 
-		frameCommandBuffers.push_back(commandBuffer);
+		// acquireNextImage waited for the frame that last used this slot
+		frameArenas[currentFrameIndex].reset();
 
-		frameCommandBuffers.push_back(computeCommandBuffer);
-
-		return frameCommandBuffers;
+		return { commandBuffer, computeCommandBuffer, currentFrameIndex, &frameArenas[currentFrameIndex] };
 	}
 
 	void Renderer::endFrame() {
@@ -153,7 +155,7 @@ namespace vr {
 		currentFrameIndex = (currentFrameIndex + 1) % VrSwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+	void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
 		assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
 		assert(
 			commandBuffer == getCurrentCommandBuffer() &&
@@ -173,8 +175,15 @@ namespace vr {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+		// Secondary command buffers do not inherit dynamic state; each sets its own
+		if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+			setViewportAndScissor(commandBuffer);
+		}
+	}
 
+	void Renderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
@@ -195,4 +204,72 @@ namespace vr {
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
+	void Renderer::recordSecondaryCommandBuffers(VkCommandBuffer commandBuffer, std::span<const SecondaryRecorder> recorders) {
+		assert(isFrameStarted && "Can't record secondary command buffers if frame is not in progress");
+		assert(
+			commandBuffer == getCurrentCommandBuffer() &&
+			"Can't execute secondary command buffers on command buffer from a different frame");
+		if (recorders.empty()) {
+			return;
+		}
+
+		// acquireNextImage waited for the frame that last used this slot, so its pools can be reset
+		std::vector<SecondaryCommands>& frameCommands = secondaryCommands[currentFrameIndex];
+		while (frameCommands.size() < recorders.size()) {
+			SecondaryCommands commands{};
+
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = vrDevice.findPhysicalQueueFamilies().graphicsFamily;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(vrDevice.device(), &poolInfo, nullptr, &commands.commandPool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create secondary command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = commands.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(vrDevice.device(), &allocInfo, &commands.commandBuffer) != VK_SUCCESS) {
+				vkDestroyCommandPool(vrDevice.device(), commands.commandPool, nullptr);
+				throw std::runtime_error("Failed to allocate secondary command buffer!");
+			}
+			frameCommands.push_back(commands);
+		}
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = vrSwapChain->getRenderPass();
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = vrSwapChain->getFrameBuffer(currentImageIndex);
+
+		recordWorkers.run(recorders.size(), [&](size_t i) {
+			const SecondaryCommands& commands = frameCommands[i];
+			vkResetCommandPool(vrDevice.device(), commands.commandPool, 0);
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			if (vkBeginCommandBuffer(commands.commandBuffer, &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to begin recording secondary command buffer");
+			}
+			setViewportAndScissor(commands.commandBuffer);
+			recorders[i](commands.commandBuffer);
+			if (vkEndCommandBuffer(commands.commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record secondary command buffer");
+			}
+		});
+
+		std::span<VkCommandBuffer> executedCommandBuffers = getFrameArena().allocateArray<VkCommandBuffer>(recorders.size());
+		for (size_t i = 0; i < recorders.size(); i++) {
+			executedCommandBuffers[i] = frameCommands[i].commandBuffer;
+		}
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(executedCommandBuffers.size()), executedCommandBuffers.data());
+	}
+
 }
\ No newline at end of file
@@ -3,16 +3,37 @@
 #include "vr_window.hpp"
 #include "vr_device.hpp"
 #include "vr_swap_chain.hpp"
+#include "frame_arena.hpp"
+#include "worker_group.hpp"
 
+#include <array>
 #include <cassert>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 
 namespace vr {
+	// Handles for the frame begun by Renderer::beginFrame. Null when no frame could be begun
+	struct FrameHandles {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE;
+		int frameIndex = 0;
+		// Scratch memory for the frame, released when its slot comes round again
+		FrameArena* arena = nullptr;
+
+		explicit operator bool() const { return commandBuffer != VK_NULL_HANDLE; }
+	};
+
 	class Renderer {
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		// Threads recording secondary command buffers besides the one calling recordSecondaryCommandBuffers
+		static constexpr uint32_t RECORD_THREAD_COUNT = 3;
+
+		// Records one part of the swap chain render pass into the secondary command buffer given
+		using SecondaryRecorder = std::function<void(VkCommandBuffer)>;
 
 		Renderer(VrWindow& window, VrDevice& device);
 		~Renderer();
@@ -22,6 +43,7 @@ namespace vr {
 
 		VkRenderPass getSwapChainRenderPass() const { return vrSwapChain->getRenderPass(); }
 		float getAspectRatio() const { return vrSwapChain->extentAspectRatio(); }
+		VkExtent2D getSwapChainExtent() const { return vrSwapChain->getSwapChainExtent(); }
 		bool isFrameInProgress() const { return isFrameStarted; }
 
 		VkCommandBuffer getCurrentCommandBuffer() const {
@@ -39,10 +61,21 @@ namespace vr {
 			return currentFrameIndex;
 		}
 
-		std::vector<VkCommandBuffer> beginFrame();
+		FrameArena& getFrameArena() {
+			assert(isFrameStarted && "Cannot get frame arena when frame not in progress");
+			return frameArenas[currentFrameIndex];
+		}
+
+		FrameHandles beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, the pass may only be filled by
+		// recordSecondaryCommandBuffers
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// Records each recorder into a secondary command buffer of its own, concurrently on worker
+		// threads, then executes them in order in the render pass. Each secondary starts with the
+		// viewport and scissor set. Recorders may run on any thread, including this one
+		void recordSecondaryCommandBuffers(VkCommandBuffer commandBuffer, std::span<const SecondaryRecorder> recorders);
 
 	private:
 
@@ -50,13 +83,25 @@ namespace vr {
 		void createComputeCommandBuffers();
 		void freeCommandBuffers();
 		void recreateSwapChain();
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
+
+		// Command pools are externally synchronized, so every secondary command buffer recorded in a
+		// frame has a pool of its own. It is reset when its frame slot comes round again
+		struct SecondaryCommands {
+			VkCommandPool commandPool;
+			VkCommandBuffer commandBuffer;
+		};
 
 		VrWindow& vrWindow;
 		VrDevice& vrDevice;
 		std::unique_ptr<VrSwapChain> vrSwapChain;
 		std::vector<VkCommandBuffer> commandBuffers;
 		std::vector<VkCommandBuffer> computeCommandBuffers;
-		std::vector<VkCommandBuffer> frameCommandBuffers;
+
+		// Per frame in flight, one per recorder, grown to the most recorders seen
+		std::array<std::vector<SecondaryCommands>, VrSwapChain::MAX_FRAMES_IN_FLIGHT> secondaryCommands;
+		std::array<FrameArena, VrSwapChain::MAX_FRAMES_IN_FLIGHT> frameArenas;
+		WorkerGroup recordWorkers{ RECORD_THREAD_COUNT };
 
 		uint32_t currentImageIndex;
 		int currentFrameIndex{ 0 };
@@ -0,0 +1,135 @@
+#include "sh_codebook.hpp"
+
+#include "sh_degree.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace vr {
+
+	namespace {
+		constexpr size_t ASSIGN_CHUNK_SIZE = 1024;
+
+		// Squared distance over count floats that stops early once it exceeds limit
+		float distanceSquared(const float* a, const float* b, uint32_t count, float limit) {
+			float sum = 0.f;
+			for (uint32_t k = 0; k < count; k++) {
+				float d = a[k] - b[k];
+				sum += d * d;
+				if (sum >= limit) {
+					break;
+				}
+			}
+			return sum;
+		}
+	}
+
+	ShCodebook::ShCodebook(std::vector<float> entries, uint32_t restCount)
+		: entries{ std::move(entries) }, restCount{ restCount } {
+		if (restCount == 0 || this->entries.empty() || this->entries.size() % restCount != 0 || getSize() > MAX_SIZE) {
+			throw std::runtime_error("Invalid SH codebook size");
+		}
+	}
+
+	uint32_t ShCodebook::findNearest(const float* rest) const {
+		uint32_t best = 0;
+		float bestDistance = std::numeric_limits<float>::max();
+
+		for (uint32_t i = 0; i < getSize(); i++) {
+			float distance = distanceSquared(rest, getEntry(i), restCount, bestDistance);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = i;
+			}
+		}
+		return best;
+	}
+
+	std::unique_ptr<ShCodebook> ShCodebook::train(
+		const float* samples,
+		size_t sampleCount,
+		uint32_t shDegree,
+		const ShCodebookSettings& settings,
+		ThreadPool& pool) {
+		if (sampleCount == 0) {
+			throw std::runtime_error("Cannot train an SH codebook without samples");
+		}
+		if (shDegree == 0 || shDegree > MAX_SH_DEGREE) {
+			throw std::runtime_error("Cannot train an SH codebook for SH degree " + std::to_string(shDegree));
+		}
+
+		const uint32_t size = static_cast<uint32_t>(std::min<size_t>({ settings.size, sampleCount, MAX_SIZE }));
+		const uint32_t stride = shCoefficientCount(shDegree);
+		const uint32_t dims = stride - 3;
+
+		auto restOf = [samples, stride](size_t index) {
+			return samples + index * stride + 3;
+		};
+
+		// Seed with samples spread evenly over the input
+		std::vector<float> entries(static_cast<size_t>(size) * dims);
+		for (uint32_t c = 0; c < size; c++) {
+			const float* seed = restOf(static_cast<size_t>(c) * sampleCount / size);
+			std::copy(seed, seed + dims, entries.begin() + static_cast<size_t>(c) * dims);
+		}
+		ShCodebook codebook{ std::move(entries), dims };
+
+		const size_t chunkCount = (sampleCount + ASSIGN_CHUNK_SIZE - 1) / ASSIGN_CHUNK_SIZE;
+		std::vector<uint32_t> assignments(sampleCount);
+		std::vector<double> chunkErrors(chunkCount);
+
+		for (uint32_t iteration = 0; iteration < settings.iterations; iteration++) {
+			// The nearest-entry search dominates, so only it runs on the pool; the
+			// accumulation below is a single cheap pass
+			pool.parallelFor(sampleCount, ASSIGN_CHUNK_SIZE, [&](size_t begin, size_t end) {
+				double chunkError = 0.0;
+				for (size_t i = begin; i < end; i++) {
+					const float* rest = restOf(i);
+					assignments[i] = codebook.findNearest(rest);
+					chunkError += distanceSquared(rest, codebook.getEntry(assignments[i]), dims, std::numeric_limits<float>::max());
+				}
+				chunkErrors[begin / ASSIGN_CHUNK_SIZE] = chunkError;
+			});
+
+			std::vector<double> sums(static_cast<size_t>(size) * dims, 0.0);
+			std::vector<uint32_t> counts(size, 0);
+			for (size_t i = 0; i < sampleCount; i++) {
+				const float* rest = restOf(i);
+				double* sum = sums.data() + static_cast<size_t>(assignments[i]) * dims;
+				for (uint32_t k = 0; k < dims; k++) {
+					sum[k] += rest[k];
+				}
+				counts[assignments[i]]++;
+			}
+
+			double error = 0.0;
+			for (double chunkError : chunkErrors) {
+				error += chunkError;
+			}
+
+			uint32_t emptyClusters = 0;
+			for (uint32_t c = 0; c < size; c++) {
+				float* entry = codebook.entries.data() + static_cast<size_t>(c) * dims;
+				if (counts[c] == 0) {
+					// Reseed empty clusters on a sample that moves with the iteration
+					const float* seed = restOf((static_cast<size_t>(c) * 7919 + iteration * 104729) % sampleCount);
+					std::copy(seed, seed + dims, entry);
+					emptyClusters++;
+					continue;
+				}
+				for (uint32_t k = 0; k < dims; k++) {
+					entry[k] = static_cast<float>(sums[static_cast<size_t>(c) * dims + k] / counts[c]);
+				}
+			}
+
+			std::cout << "SH codebook iteration " << iteration + 1 << "/" << settings.iterations
+				<< ": mean squared error " << error / static_cast<double>(sampleCount)
+				<< ", " << emptyClusters << " empty clusters" << std::endl;
+		}
+
+		return std::make_unique<ShCodebook>(std::move(codebook.entries), dims);
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vr {
+
+	struct ShCodebookSettings {
+		// Entries in the codebook; at most 65536 so an index fits in 16 bits
+		uint32_t size = 4096;
+		// Lloyd iterations run on the training sample
+		uint32_t iterations = 8;
+		// Splats the codebook is trained on, drawn evenly across the scene
+		uint32_t sampleCount = 64 * 1024;
+	};
+
+	// Shared table of higher-order SH vectors (every f_rest_ coefficient of a scene). Splats
+	// using ShPrecision::Codebook store only their DC color and the index of the nearest entry.
+	class ShCodebook {
+	public:
+		static constexpr uint32_t MAX_SIZE = 65536;
+
+		// entries holds getSize() vectors of restCount floats each
+		ShCodebook(std::vector<float> entries, uint32_t restCount);
+
+		// Runs k-means on samples, each shCoefficientCount(shDegree) floats whose first three
+		// (DC) are ignored. The nearest-entry search is split across pool.
+		static std::unique_ptr<ShCodebook> train(
+			const float* samples,
+			size_t sampleCount,
+			uint32_t shDegree,
+			const ShCodebookSettings& settings,
+			ThreadPool& pool);
+
+		uint32_t getRestCount() const { return restCount; }
+		uint32_t getSize() const { return static_cast<uint32_t>(entries.size() / restCount); }
+		const std::vector<float>& getEntries() const { return entries; }
+		const float* getEntry(uint32_t index) const { return entries.data() + static_cast<size_t>(index) * restCount; }
+
+		// Index of the entry closest to rest (getRestCount() floats) in squared distance
+		uint32_t findNearest(const float* rest) const;
+
+	private:
+		std::vector<float> entries;
+		uint32_t restCount;
+	};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace vr {
+
+	constexpr uint32_t MAX_SH_DEGREE = 3;
+
+	// SH basis functions per color channel up to degree
+	constexpr uint32_t shBasisCount(uint32_t degree) {
+		return (degree + 1) * (degree + 1);
+	}
+
+	// Floats per splat: the three DC terms, then the higher-order bands of R, G and B in turn,
+	// which is the f_dc / f_rest order of the PLY
+	constexpr uint32_t shCoefficientCount(uint32_t degree) {
+		return 3 * shBasisCount(degree);
+	}
+
+	// Compile-time SH layout, so per-splat loops only touch the coefficients a scene has
+	template <uint32_t Degree>
+	struct ShLayout {
+		static_assert(Degree <= MAX_SH_DEGREE, "SH degree out of range");
+
+		static constexpr uint32_t DEGREE = Degree;
+		static constexpr uint32_t BASIS_COUNT = shBasisCount(Degree);
+		static constexpr uint32_t COEFFICIENT_COUNT = shCoefficientCount(Degree);
+		static constexpr uint32_t REST_COUNT = COEFFICIENT_COUNT - 3;
+	};
+
+	// Calls fn(ShLayout<degree>{}) for a degree only known at run time
+	template <typename Fn>
+	decltype(auto) dispatchShDegree(uint32_t degree, Fn&& fn) {
+		switch (degree) {
+		case 0: return fn(ShLayout<0>{});
+		case 1: return fn(ShLayout<1>{});
+		case 2: return fn(ShLayout<2>{});
+		case 3: return fn(ShLayout<3>{});
+		}
+		throw std::runtime_error("Unsupported SH degree " + std::to_string(degree));
+	}
+}
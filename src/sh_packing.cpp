@@ -0,0 +1,248 @@
+#include "sh_packing.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vr {
+
+	namespace {
+		// Multiple of SH_QUANTIZATION_BLOCK_SIZE so every chunk starts a block
+		constexpr size_t PACK_CHUNK_SIZE = 16 * 1024;
+		static_assert(PACK_CHUNK_SIZE % SH_QUANTIZATION_BLOCK_SIZE == 0);
+
+		constexpr uint32_t wordAligned(uint32_t bytes) {
+			return (bytes + 3) / 4 * 4;
+		}
+
+		void accumulate(ShPackingError& error, float source, float decoded) {
+			float difference = std::abs(source - decoded);
+			error.squaredErrorSum += static_cast<double>(difference) * difference;
+			error.maxError = std::max(error.maxError, difference);
+			error.coefficientCount++;
+		}
+
+		template <typename Layout>
+		ShPackingError packFloat16(const float* src, size_t count, uint8_t* out) {
+			constexpr uint32_t N = Layout::COEFFICIENT_COUNT;
+			ShPackingError error{};
+			// Zero pads an odd coefficient count to a whole word
+			uint16_t packed[wordAligned(N * sizeof(uint16_t)) / sizeof(uint16_t)]{};
+
+			for (size_t i = 0; i < count; i++) {
+				for (uint32_t k = 0; k < N; k++) {
+					packed[k] = glm::packHalf1x16(src[i * N + k]);
+					accumulate(error, src[i * N + k], glm::unpackHalf1x16(packed[k]));
+				}
+				std::memcpy(out + i * sizeof(packed), packed, sizeof(packed));
+			}
+			error.splatCount = count;
+			return error;
+		}
+
+		template <typename Layout>
+		ShPackingError packUInt8(const float* src, size_t count, uint8_t* out, ShQuantizationBlock* blocksDst) {
+			constexpr uint32_t N = Layout::COEFFICIENT_COUNT;
+			ShPackingError error{};
+			uint8_t packed[wordAligned(N)]{};
+
+			for (size_t first = 0; first < count; first += SH_QUANTIZATION_BLOCK_SIZE) {
+				size_t last = std::min(count, first + SH_QUANTIZATION_BLOCK_SIZE);
+
+				ShQuantizationBlock block{};
+				for (uint32_t k = 0; k < N; k++) {
+					float minValue = src[first * N + k];
+					float maxValue = minValue;
+					for (size_t i = first + 1; i < last; i++) {
+						minValue = std::min(minValue, src[i * N + k]);
+						maxValue = std::max(maxValue, src[i * N + k]);
+					}
+					block.offset[k] = minValue;
+					block.scale[k] = maxValue - minValue;
+				}
+
+				for (size_t i = first; i < last; i++) {
+					for (uint32_t k = 0; k < N; k++) {
+						float normalized = block.scale[k] > 0.f ? (src[i * N + k] - block.offset[k]) / block.scale[k] : 0.f;
+						packed[k] = static_cast<uint8_t>(std::lround(std::clamp(normalized, 0.f, 1.f) * 255.f));
+						accumulate(error, src[i * N + k], block.offset[k] + packed[k] / 255.f * block.scale[k]);
+					}
+					std::memcpy(out + i * sizeof(packed), packed, sizeof(packed));
+				}
+
+				std::memcpy(blocksDst + first / SH_QUANTIZATION_BLOCK_SIZE, &block, sizeof(block));
+			}
+			error.splatCount = count;
+			return error;
+		}
+
+		template <typename Layout>
+		ShPackingError packCodebook(const float* src, size_t count, uint8_t* out, const ShCodebook& codebook) {
+			constexpr uint32_t N = Layout::COEFFICIENT_COUNT;
+			ShPackingError error{};
+
+			for (size_t i = 0; i < count; i++) {
+				const float* coefficients = src + i * N;
+				uint16_t dc[3];
+				for (uint32_t k = 0; k < 3; k++) {
+					dc[k] = glm::packHalf1x16(coefficients[k]);
+					accumulate(error, coefficients[k], glm::unpackHalf1x16(dc[k]));
+				}
+
+				uint32_t index = codebook.findNearest(coefficients + 3);
+				const float* entry = codebook.getEntry(index);
+				for (uint32_t k = 0; k < Layout::REST_COUNT; k++) {
+					accumulate(error, coefficients[3 + k], entry[k]);
+				}
+
+				// Matches the reads in sh_decode.glsl: half2(dc.r, dc.g), then dc.b | index << 16
+				uint32_t packed[2] = {
+					static_cast<uint32_t>(dc[0]) | static_cast<uint32_t>(dc[1]) << 16,
+					static_cast<uint32_t>(dc[2]) | index << 16,
+				};
+				std::memcpy(out + i * sizeof(packed), packed, sizeof(packed));
+			}
+			error.splatCount = count;
+			return error;
+		}
+	}
+
+	void ShPackingError::merge(const ShPackingError& other) {
+		squaredErrorSum += other.squaredErrorSum;
+		maxError = std::max(maxError, other.maxError);
+		coefficientCount += other.coefficientCount;
+		splatCount += other.splatCount;
+	}
+
+	double ShPackingError::rms() const {
+		return coefficientCount > 0 ? std::sqrt(squaredErrorSum / static_cast<double>(coefficientCount)) : 0.0;
+	}
+
+	double ShPackingError::colorRms() const {
+		double channelCount = 3.0 * static_cast<double>(splatCount);
+		if (channelCount == 0.0) {
+			return 0.0;
+		}
+		return std::sqrt(squaredErrorSum / channelCount / (4.0 * std::numbers::pi));
+	}
+
+	ShPacker::ShPacker(ShPrecision precision, uint32_t shDegree, std::shared_ptr<const ShCodebook> codebook)
+		: precision{ precision }, shDegree{ shDegree }, codebook{ std::move(codebook) } {
+		if (shDegree > MAX_SH_DEGREE) {
+			throw std::runtime_error("Unsupported SH degree " + std::to_string(shDegree));
+		}
+		if (precision == ShPrecision::Codebook) {
+			if (shDegree == 0) {
+				throw std::runtime_error("ShPrecision::Codebook requires SH degree 1 or higher");
+			}
+			if (!this->codebook) {
+				throw std::runtime_error("ShPrecision::Codebook requires a trained codebook");
+			}
+			if (this->codebook->getRestCount() != shCoefficientCount(shDegree) - 3) {
+				throw std::runtime_error("SH codebook was trained for a different SH degree");
+			}
+		}
+	}
+
+	const char* ShPacker::getPrecisionName() const {
+		switch (precision) {
+		case ShPrecision::Float32: return "fp32";
+		case ShPrecision::Float16: return "fp16";
+		case ShPrecision::UInt8: return "u8";
+		case ShPrecision::Codebook: return "codebook";
+		}
+		return "unknown";
+	}
+
+	uint32_t ShPacker::getPackedStride() const {
+		const uint32_t coefficientCount = shCoefficientCount(shDegree);
+
+		switch (precision) {
+		case ShPrecision::Float32: return coefficientCount * sizeof(float);
+		case ShPrecision::Float16: return wordAligned(coefficientCount * sizeof(uint16_t));
+		case ShPrecision::UInt8: return wordAligned(coefficientCount * sizeof(uint8_t));
+		case ShPrecision::Codebook: return 2 * sizeof(uint32_t);
+		}
+		return 0;
+	}
+
+	uint32_t ShPacker::getBlockCount(size_t count) const {
+		if (precision != ShPrecision::UInt8) {
+			return 0;
+		}
+		return static_cast<uint32_t>((count + SH_QUANTIZATION_BLOCK_SIZE - 1) / SH_QUANTIZATION_BLOCK_SIZE);
+	}
+
+	ShPackingError ShPacker::pack(
+		const float* src,
+		size_t count,
+		void* dst,
+		ShQuantizationBlock* blocksDst,
+		ThreadPool* pool) const {
+		auto out = static_cast<uint8_t*>(dst);
+
+		if (!pool || count <= PACK_CHUNK_SIZE) {
+			return packRange(src, count, out, blocksDst);
+		}
+
+		const uint32_t coefficientCount = shCoefficientCount(shDegree);
+		std::vector<ShPackingError> chunkErrors((count + PACK_CHUNK_SIZE - 1) / PACK_CHUNK_SIZE);
+		pool->parallelFor(count, PACK_CHUNK_SIZE, [&](size_t begin, size_t end) {
+			chunkErrors[begin / PACK_CHUNK_SIZE] = packRange(
+				src + begin * coefficientCount,
+				end - begin,
+				out + begin * getPackedStride(),
+				blocksDst ? blocksDst + begin / SH_QUANTIZATION_BLOCK_SIZE : nullptr);
+		});
+
+		ShPackingError error{};
+		for (const auto& chunkError : chunkErrors) {
+			error.merge(chunkError);
+		}
+		return error;
+	}
+
+	ShPackingError ShPacker::packRange(const float* src, size_t count, uint8_t* out, ShQuantizationBlock* blocksDst) const {
+		return dispatchShDegree(shDegree, [&](auto layout) {
+			using Layout = decltype(layout);
+
+			switch (precision) {
+			case ShPrecision::Float16:
+				return packFloat16<Layout>(src, count, out);
+			case ShPrecision::UInt8:
+				return packUInt8<Layout>(src, count, out, blocksDst);
+			case ShPrecision::Codebook:
+				if constexpr (Layout::DEGREE > 0) {
+					return packCodebook<Layout>(src, count, out, *codebook);
+				}
+				break;
+			case ShPrecision::Float32:
+				break;
+			}
+
+			std::memcpy(out, src, count * Layout::COEFFICIENT_COUNT * sizeof(float));
+			ShPackingError error{};
+			error.splatCount = count;
+			return error;
+		});
+	}
+
+	void printShPackingReport(const ShPacker& packer, size_t count, const ShPackingError& error) {
+		float megabytes = static_cast<float>(count) * packer.getPackedStride() / (1024.f * 1024.f);
+		if (packer.getCodebook()) {
+			megabytes += static_cast<float>(packer.getCodebook()->getEntries().size() * sizeof(float)) / (1024.f * 1024.f);
+		}
+		float fp32Megabytes = static_cast<float>(count) * shCoefficientCount(packer.getShDegree()) * sizeof(float) / (1024.f * 1024.f);
+
+		std::cout << "SH degree " << packer.getShDegree() << " packed as " << packer.getPrecisionName() << ": " << megabytes << " MB (fp32 "
+			<< fp32Megabytes << " MB), RMS error " << error.rms() << ", max error " << error.maxError
+			<< ", RMS color error " << error.colorRms() << std::endl;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "sh_codebook.hpp"
+#include "sh_degree.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace vr {
+
+	// Device-side encodings of a model's SH stream. Must match SH_PRECISION_* in
+	// shaders/sh_decode.glsl. Sizes below are for degree 3
+	enum class ShPrecision : uint32_t {
+		Float32 = 0,
+		// IEEE half floats, 96 bytes per splat
+		Float16 = 1,
+		// One byte per coefficient, 48 bytes per splat, dequantized with the offset and scale
+		// of the splat's ShQuantizationBlock
+		UInt8 = 2,
+		// fp16 DC color plus a 16-bit index into an ShCodebook of higher-order vectors, 8 bytes
+		// per splat. Needs degree 1 or higher
+		Codebook = 3,
+	};
+
+	// Coefficients per splat at the highest supported degree
+	constexpr uint32_t SH_COEFFICIENT_COUNT = shCoefficientCount(MAX_SH_DEGREE);
+	// Number of consecutive splats that share one ShQuantizationBlock
+	constexpr uint32_t SH_QUANTIZATION_BLOCK_SIZE = 256;
+
+	// Per-coefficient range of a block of splats: value = offset + q / 255 * scale. Always
+	// sized for degree 3; lower degrees leave the tail unused
+	struct ShQuantizationBlock {
+		float offset[SH_COEFFICIENT_COUNT];
+		float scale[SH_COEFFICIENT_COUNT];
+	};
+
+	// Error of the packed coefficients against the fp32 source
+	struct ShPackingError {
+		double squaredErrorSum = 0.0;
+		float maxError = 0.f;
+		uint64_t coefficientCount = 0;
+		uint64_t splatCount = 0;
+
+		void merge(const ShPackingError& other);
+		double rms() const;
+		// RMS error of the reconstructed RGB color averaged over all view directions. The SH
+		// basis is orthonormal, so this follows from the coefficient errors alone.
+		double colorRms() const;
+	};
+
+	class ShPacker {
+	public:
+		// codebook is required for, and only used by, ShPrecision::Codebook
+		ShPacker(ShPrecision precision, uint32_t shDegree, std::shared_ptr<const ShCodebook> codebook = nullptr);
+
+		ShPrecision getPrecision() const { return precision; }
+		uint32_t getShDegree() const { return shDegree; }
+		const char* getPrecisionName() const;
+		const ShCodebook* getCodebook() const { return codebook.get(); }
+
+		// Bytes per splat in the packed SH stream, padded to whole 32-bit words
+		uint32_t getPackedStride() const;
+		// Blocks needed for count splats; 0 unless the precision is quantized
+		uint32_t getBlockCount(size_t count) const;
+
+		// Packs count splats of shCoefficientCount(getShDegree()) floats from src into dst
+		// (count * getPackedStride() bytes) and, for quantized precisions, their blocks into
+		// blocksDst. The first splat must start a block. With a pool the work is split across
+		// its threads, which matters most for the codebook search.
+		ShPackingError pack(
+			const float* src,
+			size_t count,
+			void* dst,
+			ShQuantizationBlock* blocksDst,
+			ThreadPool* pool = nullptr) const;
+
+	private:
+		ShPackingError packRange(const float* src, size_t count, uint8_t* dst, ShQuantizationBlock* blocksDst) const;
+
+		ShPrecision precision;
+		uint32_t shDegree;
+		std::shared_ptr<const ShCodebook> codebook;
+	};
+
+	// Prints the packed size of count splats and the error against their fp32 source
+	void printShPackingReport(const ShPacker& packer, size_t count, const ShPackingError& error);
+}
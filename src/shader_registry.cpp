@@ -0,0 +1,20 @@
+#include "shader_registry.hpp"
+
+#include "embedded_shaders.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vr {
+
+	std::span<const uint32_t> getShaderCode(const std::string& name) {
+		const auto& entries = embedded_shaders::entries;
+		auto entry = std::find_if(std::begin(entries), std::end(entries), [&](const embedded_shaders::Entry& entry) {
+			return entry.name == name;
+		});
+		if (entry == std::end(entries)) {
+			throw std::runtime_error("No embedded shader named " + name);
+		}
+		return entry->code;
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace vr {
+
+	// SPIR-V of every shader under shaders/, compiled and embedded in the executable at build
+	// time (see cmake/EmbedShaders.cmake), looked up by source file name, e.g.
+	// "gaussian_shader.vert". Throws if there is no such shader
+	std::span<const uint32_t> getShaderCode(const std::string& name);
+}
@@ -1,23 +1,77 @@
 #include "gaussian_render.hpp"
 #include "gaussian_model.hpp"
+#include "vr_swap_chain.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <utility>
 
 namespace vr {
 
     struct GaussianPushConstantData {
         glm::mat4 modelMatrix{ 1.f };
-        glm::mat4 normalMatrix{ 1.f };
+        uint32_t shPrecision = 0;
+        uint32_t splatCount = 0;
+        // Only read by shaders/depth_order_refine.comp
+        uint32_t sortBlockOffset = 0;
+    };
+
+    // std430; must match shaders/projected_splat.glsl
+    struct ProjectedSplat {
+        glm::vec4 center;
+        glm::vec4 conicOpacity;
+        glm::vec3 color;
+        float radius;
     };
 
-    GaussianRenderSystem::GaussianRenderSystem(const std::string& filepath, VrDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : vrDevice{ device } {
+    namespace {
+        float secondsSince(std::chrono::high_resolution_clock::time_point startTime) {
+            auto endTime = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<float, std::chrono::seconds::period>(endTime - startTime).count();
+        }
+
+        void printThroughput(const char* stage, size_t numVertices, size_t bytes, float seconds) {
+            seconds = std::max(seconds, 1e-6f);
+            float megabytes = static_cast<float>(bytes) / (1024.f * 1024.f);
+            std::cout << stage << " " << numVertices << " gaussians in " << seconds * 1000.f << " ms ("
+                << megabytes / seconds << " MB/s, " << static_cast<float>(numVertices) / seconds / 1e6f
+                << " M splats/s)" << std::endl;
+        }
+    }
+
+    GaussianRenderSystem::GaussianRenderSystem(
+        const std::string& filepath,
+        VrDevice& device,
+        VkRenderPass renderPass,
+        VkDescriptorSetLayout globalSetLayout,
+        const GaussianLoadOptions& options) : options{ options }, vrDevice{ device } {
         if (!std::filesystem::exists(filepath)) {
             throw std::runtime_error("File does not exist: " + filepath);
         }
         else {
-            createPipelineLayout(globalSetLayout);
-            createPipeline(renderPass);
             filename = filepath;
+            // Loaded first so the pipelines can be specialized for the scene's SH degree
             GaussianRenderSystem::load();
+            createModelSetLayout();
+            createViewSetLayout();
+            createPipelineLayout(globalSetLayout);
+            createPipeline(renderPass);
+            const bool incrementalSort =
+                options.renderPath == GaussianRenderPath::Raster && options.sortMode == GaussianSortMode::Incremental;
+            // Incremental sorting adds a depth order per model to the per-frame sort buffers
+            radixSort = std::make_unique<GpuRadixSort>(
+                vrDevice,
+                MAX_MODELS * (VrSwapChain::MAX_FRAMES_IN_FLIGHT + (incrementalSort ? 1 : 0)));
+            if (incrementalSort) {
+                depthOrderCompact = std::make_unique<GpuCompact>(vrDevice, MAX_MODELS * VrSwapChain::MAX_FRAMES_IN_FLIGHT);
+            }
+            if (options.renderPath == GaussianRenderPath::TileCompute) {
+                tileRasterizer = std::make_unique<GaussianTileRasterizer>(vrDevice, renderPass, MAX_MODELS);
+            }
         }
     }
 
@@ -26,33 +80,469 @@ namespace vr {
     };
 
     void GaussianRenderSystem::load() {
+        if (options.useSceneCache && loadSceneCache()) {
+            return;
+        }
+
+        if (options.plyLoadMode == PlyLoadMode::MemoryMapped) {
+            loadMapped();
+        }
+        else {
+            loadBuffered();
+        }
+    }
+
+    std::shared_ptr<GaussianModel> GaussianRenderSystem::createModel() {
+        auto model = options.streaming ? createStreamingModel() : createUploadedModel();
+        model->createDescriptorSet(*modelSetLayout, *modelPool);
+        createModelView(*model);
+        return model;
+    }
+
+    void GaussianRenderSystem::createModelView(const GaussianModel& model) {
+        ModelView view{};
+        view.model = &model;
+
+        if (depthOrderCompact) {
+            view.depthOrder = std::make_unique<DepthOrder>();
+            view.depthOrder->sortBuffers = radixSort->createBuffers(model.getCapacity());
+            view.depthOrder->visibleFlags = std::make_unique<Buffer>(
+                vrDevice,
+                sizeof(uint32_t),
+                std::max(model.getCapacity(), 1u),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+        }
+
+        for (int i = 0; i < VrSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            auto projectedSplats = std::make_unique<Buffer>(
+                vrDevice,
+                sizeof(ProjectedSplat),
+                std::max(model.getCapacity(), 1u),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+
+            auto sortBuffers = radixSort->createBuffers(model.getCapacity());
+
+            auto visibleOffsets = std::make_unique<Buffer>(
+                vrDevice,
+                sizeof(uint32_t),
+                std::max((model.getCapacity() + PREPROCESS_WORKGROUP_SIZE - 1) / PREPROCESS_WORKGROUP_SIZE, 1u),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+
+            auto drawCommand = std::make_unique<Buffer>(
+                vrDevice,
+                sizeof(VkDrawIndirectCommand),
+                1,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+
+            auto projectedInfo = projectedSplats->descriptorInfo();
+            auto depthKeysInfo = sortBuffers->keys->descriptorInfo();
+            auto sortedSplatsInfo = sortBuffers->values->descriptorInfo();
+            auto visibleOffsetsInfo = visibleOffsets->descriptorInfo();
+            auto drawCommandInfo = drawCommand->descriptorInfo();
+            auto visibleCountInfo = sortBuffers->count->descriptorInfo();
+            VrDescriptorWriter writer{ *viewSetLayout, *viewPool };
+            writer
+                .writeBuffer(0, &projectedInfo)
+                .writeBuffer(1, &depthKeysInfo)
+                .writeBuffer(2, &sortedSplatsInfo)
+                .writeBuffer(3, &visibleOffsetsInfo)
+                .writeBuffer(4, &drawCommandInfo)
+                .writeBuffer(5, &visibleCountInfo);
+
+            // The depth order bindings are only read by the incremental sort's pipelines
+            VkDescriptorBufferInfo depthOrderKeysInfo{};
+            VkDescriptorBufferInfo depthOrderInfo{};
+            VkDescriptorBufferInfo depthOrderVisibleInfo{};
+            if (view.depthOrder) {
+                DepthOrder& depthOrder = *view.depthOrder;
+                depthOrderKeysInfo = depthOrder.sortBuffers->keys->descriptorInfo();
+                depthOrderInfo = depthOrder.sortBuffers->values->descriptorInfo();
+                depthOrderVisibleInfo = depthOrder.visibleFlags->descriptorInfo();
+                writer
+                    .writeBuffer(6, &depthOrderKeysInfo)
+                    .writeBuffer(7, &depthOrderInfo)
+                    .writeBuffer(8, &depthOrderVisibleInfo);
+
+                depthOrder.compaction.push_back(depthOrderCompact->createBindings(
+                    depthOrderInfo,
+                    depthOrderVisibleInfo,
+                    sortedSplatsInfo,
+                    visibleCountInfo,
+                    model.getCapacity()));
+            }
+
+            VkDescriptorSet descriptorSet;
+            if (!writer.build(descriptorSet)) {
+                throw std::runtime_error("Failed to allocate gaussian view descriptor set");
+            }
+
+            view.projectedSplats.push_back(std::move(projectedSplats));
+            view.sortBuffers.push_back(std::move(sortBuffers));
+            view.visibleOffsets.push_back(std::move(visibleOffsets));
+            view.drawCommands.push_back(std::move(drawCommand));
+            view.descriptorSets.push_back(descriptorSet);
+        }
+
+        if (tileRasterizer) {
+            tileRasterizer->addModel(model, view.projectedSplats);
+        }
+
+        modelViews.push_back(std::move(view));
+    }
+
+    const GaussianRenderSystem::ModelView& GaussianRenderSystem::getModelView(const GaussianModel& model) const {
+        for (const auto& view : modelViews) {
+            if (view.model == &model) {
+                return view;
+            }
+        }
+        throw std::runtime_error("Gaussian model was not created by this render system");
+    }
+
+    GaussianRenderSystem::ModelView& GaussianRenderSystem::getModelView(const GaussianModel& model) {
+        return const_cast<ModelView&>(std::as_const(*this).getModelView(model));
+    }
+
+    std::shared_ptr<GaussianModel> GaussianRenderSystem::createUploadedModel() {
         auto startTime = std::chrono::high_resolution_clock::now();
+        GaussianModel::Builder builder{};
+        builder.shDegree = shDegree;
+        builder.shPrecision = options.shPrecision;
+        builder.shPackPool = &workerPool();
+        if (options.shPrecision == ShPrecision::Codebook) {
+            builder.shCodebook = trainShCodebook();
+        }
 
-        std::ifstream plyFile(filename, std::ios::binary);
-        loadPlyHeader(plyFile);
+        if (sceneCache) {
+            const size_t numVertices = static_cast<size_t>(sceneCache->getGaussianCount());
+            const size_t cacheSize = numVertices * (sizeof(GaussianModel::PositionOpacity) +
+                sizeof(GaussianModel::Covariance) + shCoefficientCount(shDegree) * sizeof(float));
 
-        std::cout << "Num vertices " << header.numVertices << std::endl;
+            builder.gaussianCount = static_cast<uint32_t>(numVertices);
+            builder.writeGaussians = [this](size_t first, size_t count, const GaussianModel::SplatStreams& dst) {
+                sceneCache->copyTo(first, count, dst);
+            };
+            auto model = std::make_shared<GaussianModel>(vrDevice, builder);
+            sceneCache.reset();
+
+            printThroughput("Uploaded cached", numVertices, cacheSize, secondsSince(startTime));
+            return model;
+        }
 
-        for (auto i = 0; i < header.numVertices; i++) {
-            assert(plyFile.is_open());
-            assert(!plyFile.eof());
-            GaussianModel::Gaussian gaussianData;
-            plyFile.read(reinterpret_cast<char*>(&gaussianData), sizeof(GaussianModel::Gaussian));
-            gaussianStorage.push_back(gaussianData);
+        if (!mappedFile) {
+            builder.gaussianCount = static_cast<uint32_t>(splatStorage.size());
+            builder.writeGaussians = [this](size_t first, size_t count, const GaussianModel::SplatStreams& dst) {
+                splatStorage.copyTo(first, count, dst);
+            };
+            return std::make_shared<GaussianModel>(vrDevice, builder);
         }
 
-        auto endTime = std::chrono::high_resolution_clock::now();
+        const char* body = mappedFile->data() + bodyOffset;
+        const size_t numVertices = static_cast<size_t>(header.numVertices);
+        const size_t stride = decoder->getVertexStride();
+        const size_t bodySize = numVertices * stride;
+
+        std::unique_ptr<VgsWriter> cacheWriter = options.useSceneCache ? createSceneCacheWriter() : nullptr;
+
+        builder.gaussianCount = static_cast<uint32_t>(numVertices);
+        // Decoding happens piece by piece as the model fills the staging ring
+        float decodeSeconds = 0.f;
+        GaussianModel::SplatData block{ shDegree };
+        if (cacheWriter) {
+            block.resize(std::min(CACHE_BLOCK_SIZE, numVertices));
+        }
+
+        builder.writeGaussians = [&](size_t first, size_t count, const GaussianModel::SplatStreams& dst) {
+            auto decodeStartTime = std::chrono::high_resolution_clock::now();
+
+            if (!cacheWriter) {
+                decodeParallel(body + first * stride, count, dst);
+            }
+            else {
+                // Staging memory is write-combined, so splats bound for the cache are decoded
+                // into a host block first rather than read back from dst
+                for (size_t offset = 0; offset < count; offset += CACHE_BLOCK_SIZE) {
+                    size_t blockCount = std::min(CACHE_BLOCK_SIZE, count - offset);
+                    decodeParallel(body + (first + offset) * stride, blockCount, block.streams());
+
+                    block.copyTo(0, blockCount, dst.offset(offset));
+                    cacheWriter->append(block.streams(), blockCount);
+                }
+            }
+
+            decodeSeconds += secondsSince(decodeStartTime);
+        };
+        auto model = std::make_shared<GaussianModel>(vrDevice, builder);
+
+        // The model owns the only copy of the data now, so the mapping can go
+        mappedFile.reset();
+
+        printThroughput("Decoded", numVertices, bodySize, decodeSeconds);
+        printThroughput("Decoded and uploaded", numVertices, bodySize, secondsSince(startTime));
+
+        if (cacheWriter) {
+            finishSceneCache(std::move(cacheWriter));
+        }
+
+        return model;
+    }
+
+    std::shared_ptr<GaussianModel> GaussianRenderSystem::createStreamingModel() {
+        const size_t numVertices = static_cast<size_t>(header.numVertices);
+        if (numVertices == 0) {
+            throw std::runtime_error("No gaussians to stream from: " + filename);
+        }
+
+        std::shared_ptr<const ShCodebook> shCodebook;
+        if (options.shPrecision == ShPrecision::Codebook) {
+            shCodebook = trainShCodebook();
+        }
+
+        if (mappedFile && !sceneCache && options.useSceneCache) {
+            streamCacheWriter = createSceneCacheWriter();
+        }
+
+        GaussianStreamer::Source source = [this, numVertices](size_t first, size_t count, const GaussianModel::SplatStreams& dst) {
+            readSplats(first, count, dst);
+
+            if (streamCacheWriter) {
+                streamCacheWriter->append(dst, count);
+            }
+
+            if (first + count == numVertices) {
+                // Only the streaming thread touches these until it finishes
+                if (streamCacheWriter) {
+                    finishSceneCache(std::move(streamCacheWriter));
+                }
+                mappedFile.reset();
+            }
+        };
+
+        auto model = std::make_shared<GaussianModel>(
+            vrDevice,
+            static_cast<uint32_t>(numVertices),
+            shDegree,
+            options.shPrecision,
+            std::move(shCodebook));
+        streamer = std::make_unique<GaussianStreamer>(vrDevice, model, std::move(source), &workerPool());
+        return model;
+    }
+
+    void GaussianRenderSystem::readSplats(size_t first, size_t count, const GaussianModel::SplatStreams& dst) {
+        if (sceneCache) {
+            sceneCache->copyTo(first, count, dst);
+        }
+        else if (mappedFile) {
+            const char* body = mappedFile->data() + bodyOffset;
+            decodeParallel(body + first * decoder->getVertexStride(), count, dst);
+        }
+        else {
+            splatStorage.copyTo(first, count, dst);
+        }
+    }
+
+    std::shared_ptr<const ShCodebook> GaussianRenderSystem::trainShCodebook() {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        const size_t numVertices = static_cast<size_t>(header.numVertices);
+        const size_t sampleCount = std::min<size_t>(std::max<uint32_t>(options.shCodebook.sampleCount, 1), numVertices);
+
+        // Samples are read as evenly spaced runs so the scene is covered without decoding it all
+        const size_t runLength = std::min(CODEBOOK_SAMPLE_RUN_LENGTH, sampleCount);
+        const size_t runCount = sampleCount / runLength;
+        const size_t spacing = runCount > 1 ? (numVertices - runLength) / (runCount - 1) : 0;
+
+        GaussianModel::SplatData samples{ shDegree };
+        samples.resize(runCount * runLength);
+        for (size_t run = 0; run < runCount; run++) {
+            readSplats(run * spacing, runLength, samples.streams().offset(run * runLength));
+        }
+
+        auto codebook = ShCodebook::train(samples.sh.data(), samples.size(), shDegree, options.shCodebook, workerPool());
+
+        std::cout << "Trained " << codebook->getSize() << " entry SH codebook on " << samples.size()
+            << " splats in " << secondsSince(startTime) * 1000.f << " ms" << std::endl;
+        return codebook;
+    }
+
+    void GaussianRenderSystem::resize(VkExtent2D extent) {
+        if (tileRasterizer) {
+            tileRasterizer->resize(extent);
+        }
+    }
+
+    void GaussianRenderSystem::uploadStreamedGaussians(FrameInfo& frameInfo) {
+        if (!streamer) {
+            return;
+        }
+
+        streamer->upload(frameInfo.computeCommandBuffer, frameInfo.frameIndex);
+
+        if (streamer->isComplete()) {
+            streamer.reset();
+            sceneCache.reset();
+        }
     }
 
-    void GaussianRenderSystem::loadPlyHeader(std::ifstream& plyFile) {
+    bool GaussianRenderSystem::loadSceneCache() {
+        const std::string cachePath = sceneCachePath();
+        if (!std::filesystem::exists(cachePath)) {
+            return false;
+        }
+
+        try {
+            auto cache = std::make_unique<VgsFile>(cachePath);
+            if (!cache->matchesSource(filename)) {
+                std::cout << "Scene cache is out of date, rebuilding: " << cachePath << std::endl;
+                return false;
+            }
+
+            header = PlyHeader{};
+            header.numVertices = cache->getGaussianCount();
+            shDegree = cache->getShDegree();
+            sceneCache = std::move(cache);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Ignoring scene cache: " << e.what() << std::endl;
+            return false;
+        }
+
+        std::cout << "Num vertices " << header.numVertices << ", SH degree " << shDegree << " (from " << cachePath << ")" << std::endl;
+        return true;
+    }
+
+    std::string GaussianRenderSystem::sceneCachePath() const {
+        return std::filesystem::path(filename).replace_extension(".vgs").string();
+    }
+
+    std::unique_ptr<VgsWriter> GaussianRenderSystem::createSceneCacheWriter() {
+        try {
+            return std::make_unique<VgsWriter>(sceneCachePath(), filename, header.numVertices, shDegree);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Not writing scene cache: " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    void GaussianRenderSystem::finishSceneCache(std::unique_ptr<VgsWriter> writer) {
+        try {
+            writer->finish();
+            std::cout << "Wrote scene cache " << sceneCachePath() << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cout << "Not writing scene cache: " << e.what() << std::endl;
+        }
+    }
+
+    void GaussianRenderSystem::loadMapped() {
+        mappedFile = std::make_unique<MappedFile>(filename);
+
+        const char* begin = mappedFile->data();
+        const char* end = begin + mappedFile->size();
+
+        static const std::string endHeaderToken = "end_header";
+        const char* headerEnd = std::search(begin, end, endHeaderToken.begin(), endHeaderToken.end());
+        const char* body = std::find(headerEnd, end, '\n');
+        if (body == end) {
+            throw std::runtime_error("Could not find end of header");
+        }
+        body++;
+
+        std::istringstream headerStream(std::string(begin, body));
+        loadPlyHeader(headerStream);
+
+        decoder = std::make_unique<PlyDecoder>(header);
+        shDegree = decoder->getShDegree();
+        std::cout << "Num vertices " << header.numVertices << ", SH degree " << shDegree << std::endl;
+
+        bodyOffset = static_cast<size_t>(body - begin);
+
+        size_t bodySize = static_cast<size_t>(header.numVertices) * decoder->getVertexStride();
+        if (bodyOffset + bodySize > mappedFile->size()) {
+            throw std::runtime_error("Unexpected end of vertex data in: " + filename);
+        }
+    }
+
+    void GaussianRenderSystem::loadBuffered() {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        std::ifstream plyFile(filename, std::ios::binary);
         if (!plyFile.is_open()) {
             throw std::runtime_error("Could not open file: " + filename);
         }
+        loadPlyHeader(plyFile);
+
+        decoder = std::make_unique<PlyDecoder>(header);
+        shDegree = decoder->getShDegree();
+        std::cout << "Num vertices " << header.numVertices << ", SH degree " << shDegree << std::endl;
+
+        const size_t numVertices = static_cast<size_t>(header.numVertices);
+        const size_t stride = decoder->getVertexStride();
+        const size_t verticesPerBlock = std::max<size_t>(1, PLY_READ_BLOCK_SIZE / stride);
+
+        splatStorage = GaussianModel::SplatData{ shDegree };
+        splatStorage.resize(numVertices);
+
+        std::vector<char> block(std::min(verticesPerBlock, numVertices) * stride);
+        float decodeSeconds = 0.f;
+
+        for (size_t first = 0; first < numVertices; first += verticesPerBlock) {
+            size_t count = std::min(verticesPerBlock, numVertices - first);
+            size_t blockSize = count * stride;
+
+            plyFile.read(block.data(), static_cast<std::streamsize>(blockSize));
+            if (static_cast<size_t>(plyFile.gcount()) != blockSize) {
+                throw std::runtime_error("Unexpected end of vertex data in: " + filename);
+            }
+
+            auto decodeStartTime = std::chrono::high_resolution_clock::now();
+            decodeParallel(block.data(), count, splatStorage.streams().offset(first));
+            decodeSeconds += secondsSince(decodeStartTime);
+        }
+
+        printThroughput("Decoded", numVertices, numVertices * stride, decodeSeconds);
+        printThroughput("Loaded", numVertices, numVertices * stride, secondsSince(startTime));
+
+        if (options.useSceneCache) {
+            if (auto cacheWriter = createSceneCacheWriter()) {
+                cacheWriter->append(splatStorage.streams(), numVertices);
+                finishSceneCache(std::move(cacheWriter));
+            }
+        }
+    }
+
+    ThreadPool& GaussianRenderSystem::workerPool() {
+        if (!decodePool) {
+            decodePool = std::make_unique<ThreadPool>();
+            std::cout << "Loading on " << decodePool->getThreadCount() << " threads" << std::endl;
+        }
+        return *decodePool;
+    }
+
+    void GaussianRenderSystem::decodeParallel(const char* src, size_t count, const GaussianModel::SplatStreams& dst) {
+        const size_t stride = decoder->getVertexStride();
+        workerPool().parallelFor(count, DECODE_CHUNK_SIZE, [this, src, &dst, stride](size_t begin, size_t end) {
+            decoder->decode(src + begin * stride, end - begin, dst.offset(begin));
+        });
+    }
+
+    void GaussianRenderSystem::loadPlyHeader(std::istream& headerStream) {
+        header = PlyHeader{};
 
         std::string line;
+        std::string currentElement;
         bool headerEnd = false;
 
-        while (std::getline(plyFile, line)) {
+        while (std::getline(headerStream, line)) {
             std::istringstream iss(line);
             std::string token;
 
@@ -65,12 +555,12 @@ namespace vr {
                 iss >> header.format;
             }
             else if (token == "element") {
-                iss >> token;
+                iss >> currentElement;
 
-                if (token == "vertex") {
+                if (currentElement == "vertex") {
                     iss >> header.numVertices;
                 }
-                else if (token == "face") {
+                else if (currentElement == "face") {
                     iss >> header.numFaces;
                 }
             }
@@ -78,10 +568,13 @@ namespace vr {
                 PlyProperty property;
                 iss >> property.type >> property.name;
 
-                if (header.vertexProperties.size() < static_cast<size_t>(header.numVertices)) {
+                if (currentElement == "vertex") {
+                    if (property.type == "list") {
+                        throw std::runtime_error("List properties are not supported on vertices: " + filename);
+                    }
                     header.vertexProperties.push_back(property);
                 }
-                else {
+                else if (currentElement == "face") {
                     header.faceProperties.push_back(property);
                 }
             }
@@ -96,14 +589,52 @@ namespace vr {
         }
     }
 
+    void GaussianRenderSystem::createModelSetLayout() {
+        modelSetLayout = VrDescriptorSetLayout::Builder(vrDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+        modelPool = VrDescriptorPool::Builder(vrDevice)
+            .setMaxSets(MAX_MODELS)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_MODELS * 5)
+            .build();
+    }
+
+    void GaussianRenderSystem::createViewSetLayout() {
+        viewSetLayout = VrDescriptorSetLayout::Builder(vrDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+        viewPool = VrDescriptorPool::Builder(vrDevice)
+            .setMaxSets(MAX_MODELS * VrSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_MODELS * VrSwapChain::MAX_FRAMES_IN_FLIGHT * 9)
+            .build();
+    }
+
     void GaussianRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
 
         VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
         pushConstantRange.offset = 0;
         pushConstantRange.size = sizeof(GaussianPushConstantData);
 
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+            globalSetLayout,
+            modelSetLayout->getDescriptorSetLayout(),
+            viewSetLayout->getDescriptorSetLayout()
+        };
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -120,17 +651,22 @@ namespace vr {
     void GaussianRenderSystem::createPipeline(VkRenderPass renderPass) {
         assert(pipelineLayout != nullptr && "Cannot create pipline before pipeline layout");
 
-        auto bindingDescriptions = GaussianModel::Gaussian::getBindingDescriptions();
-        auto attributeDescriptions = GaussianModel::Gaussian::getAttributeDescriptions();
+        // The vertex stage reads splats from preprocess.comp's output, so there is no vertex input
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+        // constant_id 0 in sh_decode.glsl
+        SpecializationConstants specialization{ shDegree };
 
         PipelineConfigInfo pipelineConfig{};
-        VrPipeline::defaultPipelineConfigInfo(pipelineConfig);
+        VrPipeline::splatPipelineConfigInfo(pipelineConfig);
         pipelineConfig.renderPass = renderPass;
         pipelineConfig.pipelineLayout = pipelineLayout;
+        pipelineConfig.specializationInfo = specialization.getInfo();
         gaussianPipeline = std::make_unique<VrPipeline>(
             vrDevice,
-            "../../../shaders/gaussian_shader.vert.spv",
-            "../../../shaders/gaussian_shader.frag.spv",
+            "gaussian_shader.vert",
+            "gaussian_shader.frag",
             pipelineConfig,
             bindingDescriptions,
             attributeDescriptions
@@ -138,30 +674,188 @@ namespace vr {
 
         gaussianComputePipeline = std::make_unique<ComputePipeline>(
             vrDevice,
-            "../../../shaders/preprocess.comp.spv",
+            "preprocess.comp",
+            pipelineConfig
+        );
+        compactScanPipeline = std::make_unique<ComputePipeline>(
+            vrDevice,
+            "compact_scan.comp",
             pipelineConfig
         );
+        compactScatterPipeline = std::make_unique<ComputePipeline>(
+            vrDevice,
+            "compact_scatter.comp",
+            pipelineConfig
+        );
+
+        if (options.renderPath == GaussianRenderPath::Raster && options.sortMode == GaussianSortMode::Incremental) {
+            depthOrderKeysPipeline = std::make_unique<ComputePipeline>(
+                vrDevice,
+                "depth_order_keys.comp",
+                pipelineConfig
+            );
+            depthOrderRefinePipeline = std::make_unique<ComputePipeline>(
+                vrDevice,
+                "depth_order_refine.comp",
+                pipelineConfig
+            );
+            depthOrderFlagsPipeline = std::make_unique<ComputePipeline>(
+                vrDevice,
+                "depth_order_flags.comp",
+                pipelineConfig
+            );
+        }
     }
 
-    void GaussianRenderSystem::renderGameObjects(FrameInfo& frameInfo, std::vector<VrGameObject>& gameObjects, int& bindIdx) {
-        gaussianPipeline->bind(frameInfo.commandBuffer);
-        gaussianComputePipeline->bind(frameInfo.computeCommandBuffer);
+    void GaussianRenderSystem::bindComputeModel(FrameInfo& frameInfo, VrGameObject& obj, uint32_t sortBlockOffset) {
+        const GaussianModel& model = *obj.gaussianModel;
+
+        GaussianPushConstantData push{};
+        push.modelMatrix = obj.transform.mat4();
+        push.shPrecision = static_cast<uint32_t>(model.getShPacker().getPrecision());
+        push.splatCount = model.getGaussianCount();
+        push.sortBlockOffset = sortBlockOffset;
+
+        vkCmdPushConstants(
+            frameInfo.computeCommandBuffer,
+            pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(GaussianPushConstantData),
+            &push
+        );
 
+        VkDescriptorSet descriptorSets[] = {
+            frameInfo.globalDescriptorSet,
+            model.getDescriptorSet(),
+            getModelView(model).descriptorSets[frameInfo.frameIndex]
+        };
         vkCmdBindDescriptorSets(
             frameInfo.computeCommandBuffer,
             VK_PIPELINE_BIND_POINT_COMPUTE,
             pipelineLayout,
             0,
-            1,
-            &frameInfo.globalDescriptorSet,
+            3,
+            descriptorSets,
             0,
-            nullptr
-        );
+            nullptr);
+    }
 
-        vkCmdDispatch(
-            frameInfo.computeCommandBuffer,
-            16, 1, 1
-        );
+    void GaussianRenderSystem::updateDepthOrder(FrameInfo& frameInfo, VrGameObject& obj) {
+        VkCommandBuffer computeCommandBuffer = frameInfo.computeCommandBuffer;
+        const GaussianModel& model = *obj.gaussianModel;
+        DepthOrder& depthOrder = *getModelView(model).depthOrder;
+        const IncrementalSortSettings& settings = options.incrementalSort;
+        const uint32_t splatCount = model.getGaussianCount();
+
+        const glm::mat4 modelMatrix = obj.transform.mat4();
+        const glm::mat4& inverseView = frameInfo.camera.getInverseView();
+        const glm::vec3 cameraPosition = glm::vec3(inverseView[3]);
+        const glm::vec3 cameraForward = glm::normalize(glm::vec3(inverseView[2]));
+
+        // Streaming grows the splat count, and a moved model or a large camera step reorders
+        // more than a few block sorts can repair
+        const float rotationDegrees = glm::degrees(std::acos(glm::clamp(glm::dot(cameraForward, depthOrder.cameraForward), -1.f, 1.f)));
+        const bool rebuild =
+            depthOrder.count != splatCount ||
+            depthOrder.modelMatrix != modelMatrix ||
+            glm::distance(cameraPosition, depthOrder.cameraPosition) > settings.maxTranslation ||
+            rotationDegrees > settings.maxRotationDegrees;
+
+        const uint32_t splatGroups = ComputePipeline::groupCount(splatCount, PREPROCESS_WORKGROUP_SIZE);
+        if (rebuild) {
+            bindComputeModel(frameInfo, obj);
+            depthOrderKeysPipeline->dispatch(computeCommandBuffer, splatGroups);
+            computeBarrier(computeCommandBuffer);
+            radixSort->sort(computeCommandBuffer, *depthOrder.sortBuffers, splatCount);
+            // The sort binds its own layout over set 0
+            bindComputeModel(frameInfo, obj);
+        }
+        else {
+            for (uint32_t pass = 0; pass < settings.refinePasses; pass++) {
+                const uint32_t blockOffset = pass % 2 == 0 ? 0 : DEPTH_ORDER_BLOCK_SIZE / 2;
+                bindComputeModel(frameInfo, obj, blockOffset);
+                depthOrderRefinePipeline->dispatch(
+                    computeCommandBuffer,
+                    ComputePipeline::groupCount(splatCount + blockOffset, DEPTH_ORDER_BLOCK_SIZE));
+                computeBarrier(computeCommandBuffer);
+            }
+        }
+
+        depthOrderFlagsPipeline->dispatch(computeCommandBuffer, splatGroups);
+        computeBarrier(computeCommandBuffer);
+        depthOrderCompact->compact(computeCommandBuffer, *depthOrder.compaction[frameInfo.frameIndex], splatCount);
+
+        depthOrder.count = splatCount;
+        depthOrder.modelMatrix = modelMatrix;
+        depthOrder.cameraPosition = cameraPosition;
+        depthOrder.cameraForward = cameraForward;
+    }
+
+    void GaussianRenderSystem::renderGameObjects(FrameInfo& frameInfo, std::vector<VrGameObject>& gameObjects, int& bindIdx) {
+        VkCommandBuffer computeCommandBuffer = frameInfo.computeCommandBuffer;
+
+        // Records pipeline with every model's sets and push constants bound, and dispatchGroups(splatCount)
+        // workgroups, for the models that have splats
+        auto dispatchPerModel = [&](ComputePipeline& pipeline, auto dispatchGroups) {
+            for (auto& obj : gameObjects) {
+                const uint32_t splatCount = obj.gaussianModel->getGaussianCount();
+                if (splatCount == 0) {
+                    continue;
+                }
+
+                bindComputeModel(frameInfo, obj);
+                pipeline.dispatch(computeCommandBuffer, dispatchGroups(splatCount));
+            }
+        };
+
+        auto preprocessGroups = [](uint32_t splatCount) {
+            return ComputePipeline::groupCount(splatCount, PREPROCESS_WORKGROUP_SIZE);
+        };
+
+        dispatchPerModel(*gaussianComputePipeline, preprocessGroups);
+        computeBarrier(computeCommandBuffer);
+
+        if (tileRasterizer) {
+            tileRasterizer->beginFrame(frameInfo);
+            for (auto& obj : gameObjects) {
+                if (obj.gaussianModel->getGaussianCount() > 0) {
+                    tileRasterizer->rasterize(frameInfo, *obj.gaussianModel);
+                }
+            }
+            tileRasterizer->composite(frameInfo);
+            return;
+        }
+
+        // Compact the visible splats, so the sort and the draw only pay for those. The scan also
+        // writes the draw command
+        dispatchPerModel(*compactScanPipeline, [](uint32_t) { return 1u; });
+        computeBarrier(computeCommandBuffer);
+
+        if (options.sortMode == GaussianSortMode::Incremental) {
+            for (auto& obj : gameObjects) {
+                if (obj.gaussianModel->getGaussianCount() > 0) {
+                    updateDepthOrder(frameInfo, obj);
+                }
+            }
+        }
+        else {
+            dispatchPerModel(*compactScatterPipeline, preprocessGroups);
+            computeBarrier(computeCommandBuffer);
+
+            for (auto& obj : gameObjects) {
+                const GaussianModel& model = *obj.gaussianModel;
+                if (model.getGaussianCount() == 0) {
+                    continue;
+                }
+
+                radixSort->sortIndirect(
+                    computeCommandBuffer,
+                    *getModelView(model).sortBuffers[frameInfo.frameIndex],
+                    model.getGaussianCount());
+            }
+        }
+        gaussianPipeline->bind(frameInfo.commandBuffer);
 
         vkCmdBindDescriptorSets(
             frameInfo.commandBuffer,
@@ -174,22 +868,26 @@ namespace vr {
             nullptr);
 
         for (auto& obj : gameObjects) {
+            if (obj.gaussianModel->getGaussianCount() == 0) {
+                continue;
+            }
 
-            GaussianPushConstantData push{};
-            push.modelMatrix = obj.transform.mat4();
-            push.normalMatrix = obj.transform.normalMatrix();
-
-            vkCmdPushConstants(
+            // Compute results, including the draw's instance count, reach the graphics queue
+            // through the semaphore its submit waits on
+            const ModelView& view = getModelView(*obj.gaussianModel);
+            VkDescriptorSet viewDescriptorSet = view.descriptorSets[frameInfo.frameIndex];
+            vkCmdBindDescriptorSets(
                 frameInfo.commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
                 pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                2,
+                1,
+                &viewDescriptorSet,
                 0,
-                sizeof(GaussianPushConstantData),
-                &push
-            );
+                nullptr);
 
             obj.gaussianModel->bind(frameInfo.commandBuffer, bindIdx);
-            obj.gaussianModel->draw(frameInfo.commandBuffer);
+            obj.gaussianModel->drawIndirect(frameInfo.commandBuffer, view.drawCommands[frameInfo.frameIndex]->getBuffer());
         }
     }
-}
\ No newline at end of file
+}
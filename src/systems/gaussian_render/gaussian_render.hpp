@@ -5,7 +5,16 @@
 #include "frame_info.hpp"
 #include "./pipelines/vr_pipeline.hpp"
 #include "./pipelines/compute_pipeline.hpp"
+#include "./pipelines/gpu_radix_sort.hpp"
+#include "./pipelines/gpu_primitives.hpp"
 #include "gaussian_model.hpp"
+#include "descriptors.hpp"
+#include "mapped_file.hpp"
+#include "ply_decoder.hpp"
+#include "thread_pool.hpp"
+#include "vgs_file.hpp"
+#include "gaussian_streamer.hpp"
+#include "tile_rasterizer.hpp"
 
 #include <memory>
 #include <vector>
@@ -15,50 +24,205 @@
 
 namespace vr {
 
-	struct PlyProperty {
-		std::string type;
-		std::string name;
+	enum class PlyLoadMode {
+		// Reads the body through an ifstream into splatStorage
+		Buffered,
+		// Maps the file and decodes straight into the model's staging buffer in createModel
+		MemoryMapped
 	};
 
-	struct PlyHeader {
-		std::string format;
-		int numVertices;
-		int numFaces;
-		std::vector<PlyProperty> vertexProperties;
-		std::vector<PlyProperty> faceProperties;
+	enum class GaussianRenderPath {
+		// Preprocess, depth sort and one draw through gaussian_shader.vert/.frag
+		Raster,
+		// GaussianTileRasterizer: blends in compute and composites the result into the swap chain pass
+		TileCompute
+	};
+
+	enum class GaussianSortMode {
+		// Radix sorts the visible splats every frame
+		Full,
+		// Keeps every splat in depth order across frames and only refines last frame's order,
+		// rebuilding it when the camera moves further than IncrementalSortSettings allow
+		Incremental
+	};
+
+	struct IncrementalSortSettings {
+		// Block sort passes over last frame's order per frame, alternately offset by half a block
+		uint32_t refinePasses = 2;
+		// Camera movement since the previous frame above which the order is rebuilt with a full sort
+		float maxTranslation = 0.05f;
+		float maxRotationDegrees = 2.f;
+	};
+
+	struct GaussianLoadOptions {
+		PlyLoadMode plyLoadMode = PlyLoadMode::MemoryMapped;
+		// Loads <name>.vgs next to the PLY when it is up to date, and writes it when it is not
+		bool useSceneCache = true;
+		// Returns an empty model from createModel that fills in over the following frames
+		// through uploadStreamedGaussians, instead of blocking until the whole scene is uploaded
+		bool streaming = false;
+		// Device storage for SH coefficients; Float16 and UInt8 trade accuracy for VRAM
+		ShPrecision shPrecision = ShPrecision::Float32;
+		// Training parameters when shPrecision is ShPrecision::Codebook
+		ShCodebookSettings shCodebook{};
+		GaussianRenderPath renderPath = GaussianRenderPath::Raster;
+		// Only applies to GaussianRenderPath::Raster
+		GaussianSortMode sortMode = GaussianSortMode::Full;
+		IncrementalSortSettings incrementalSort{};
 	};
 
 	class GaussianRenderSystem {
 	public:
-		GaussianRenderSystem(const std::string& filepath, VrDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		// Size of each block read from the PLY body before it is decoded
+		static constexpr size_t PLY_READ_BLOCK_SIZE = 16 * 1024 * 1024;
+		// Number of splats decoded by one worker task
+		static constexpr size_t DECODE_CHUNK_SIZE = 16 * 1024;
+		// Number of splats decoded before they are copied to staging and the scene cache
+		static constexpr size_t CACHE_BLOCK_SIZE = 256 * 1024;
+		// Length of each contiguous run of splats read for SH codebook training
+		static constexpr size_t CODEBOOK_SAMPLE_RUN_LENGTH = 1024;
+		// Models that can have their per-model descriptor set (set 1) allocated at once
+		static constexpr uint32_t MAX_MODELS = 8;
+		// Must match local_size_x in shaders/preprocess.comp, compact_scan.comp and compact_scatter.comp
+		static constexpr uint32_t PREPROCESS_WORKGROUP_SIZE = 256;
+		// Entries bitonic sorted by one workgroup of shaders/depth_order_refine.comp
+		static constexpr uint32_t DEPTH_ORDER_BLOCK_SIZE = 512;
+
+		GaussianRenderSystem(
+			const std::string& filepath,
+			VrDevice& device,
+			VkRenderPass renderPass,
+			VkDescriptorSetLayout globalSetLayout,
+			const GaussianLoadOptions& options = {});
 		~GaussianRenderSystem();
 
 		GaussianRenderSystem(const GaussianRenderSystem&) = delete;
 		GaussianRenderSystem& operator=(const GaussianRenderSystem&) = delete;
 
 		void load();
+		std::shared_ptr<GaussianModel> createModel();
+
+		// Matches extent-sized resources to the swap chain. Call every frame on the main thread
+		// before renderGameObjects is recorded; a changed extent waits for the device to go idle
+		void resize(VkExtent2D extent);
+		// Records this frame's share of streamed splats into the compute command buffer. Must be
+		// called before renderGameObjects
+		void uploadStreamedGaussians(FrameInfo& frameInfo);
+		// Whether splats are still being streamed in, which allocates as chunks arrive
+		bool isStreaming() const { return streamer != nullptr; }
 
 		void renderGameObjects(FrameInfo& frameInfo, std::vector<VrGameObject>& gameObjects, int& bindIdx);
 
-		std::vector<GaussianModel::Gaussian> getGaussians() {
-			return gaussianStorage;
+		// Only populated in PlyLoadMode::Buffered when no scene cache was used
+		const GaussianModel::SplatData& getSplats() const {
+			return splatStorage;
 		}
 
 		uint64_t getNumVertices() const {
 			return header.numVertices;
 		}
 
+		// SH degree of the loaded scene, known once load() has run
+		uint32_t getShDegree() const {
+			return shDegree;
+		}
+
 	private:
-		void loadPlyHeader(std::ifstream& ifstream);
+		// Every splat of one model in back-to-front order, kept across frames for
+		// GaussianSortMode::Incremental. The sort buffers' keys and values are bindings 6 and 7
+		// of each frame's view set, and the visible flags binding 8
+		struct DepthOrder {
+			std::unique_ptr<GpuRadixSort::Buffers> sortBuffers;
+			std::unique_ptr<Buffer> visibleFlags;
+			// Gathers the visible splats into each frame's sorted splats, one per frame in flight
+			std::vector<std::unique_ptr<GpuCompact::Bindings>> compaction;
+			// Splats in the order, 0 until it is first built
+			uint32_t count = 0;
+			glm::mat4 modelMatrix{ 1.f };
+			glm::vec3 cameraPosition{ 0.f };
+			glm::vec3 cameraForward{ 0.f };
+		};
+
+		// Per-view outputs of one model (set 2), one copy of each buffer and set per frame in flight.
+		// The sort buffers' keys, values and count are the set's depth keys, sorted splat indices
+		// and visible count
+		struct ModelView {
+			const GaussianModel* model;
+			std::vector<std::unique_ptr<Buffer>> projectedSplats;
+			std::vector<std::unique_ptr<GpuRadixSort::Buffers>> sortBuffers;
+			std::vector<std::unique_ptr<Buffer>> visibleOffsets;
+			std::vector<std::unique_ptr<Buffer>> drawCommands;
+			std::vector<VkDescriptorSet> descriptorSets;
+			// Only with GaussianSortMode::Incremental
+			std::unique_ptr<DepthOrder> depthOrder;
+		};
+
+		void loadBuffered();
+		void loadMapped();
+		bool loadSceneCache();
+		std::shared_ptr<GaussianModel> createUploadedModel();
+		std::shared_ptr<GaussianModel> createStreamingModel();
+		void loadPlyHeader(std::istream& headerStream);
+		void decodeParallel(const char* src, size_t count, const GaussianModel::SplatStreams& dst);
+		// Reads splats [first, first + count) from whichever source load() prepared
+		void readSplats(size_t first, size_t count, const GaussianModel::SplatStreams& dst);
+		std::shared_ptr<const ShCodebook> trainShCodebook();
+		ThreadPool& workerPool();
+
+		std::string sceneCachePath() const;
+		std::unique_ptr<VgsWriter> createSceneCacheWriter();
+		void finishSceneCache(std::unique_ptr<VgsWriter> writer);
+
+		void createModelView(const GaussianModel& model);
+		const ModelView& getModelView(const GaussianModel& model) const;
+		ModelView& getModelView(const GaussianModel& model);
+		// Pushes obj's constants and binds sets 0-2 of pipelineLayout for compute
+		void bindComputeModel(FrameInfo& frameInfo, VrGameObject& obj, uint32_t sortBlockOffset = 0);
+		// Records the update of the model's depth order and the gather of its visible splats into
+		// this frame's sorted splats
+		void updateDepthOrder(FrameInfo& frameInfo, VrGameObject& obj);
+
+		void createModelSetLayout();
+		void createViewSetLayout();
 		void createPipelineLayout(VkDescriptorSetLayout globalLayout);
 		void createPipeline(VkRenderPass renderPass);
 
 		std::string filename;
 		PlyHeader header;
+		GaussianLoadOptions options;
 		VrDevice& vrDevice;
-		std::vector<GaussianModel::Gaussian> gaussianStorage;
+		GaussianModel::SplatData splatStorage;
+		uint32_t shDegree = MAX_SH_DEGREE;
+
+		std::unique_ptr<VgsFile> sceneCache;
+
+		std::unique_ptr<MappedFile> mappedFile;
+		std::unique_ptr<PlyDecoder> decoder;
+		std::unique_ptr<ThreadPool> decodePool;
+		size_t bodyOffset = 0;
+		std::unique_ptr<VgsWriter> streamCacheWriter;
+
+		std::unique_ptr<VrDescriptorSetLayout> modelSetLayout;
+		std::unique_ptr<VrDescriptorPool> modelPool;
+		std::unique_ptr<VrDescriptorSetLayout> viewSetLayout;
+		std::unique_ptr<VrDescriptorPool> viewPool;
+		std::vector<ModelView> modelViews;
+
 		std::unique_ptr<VrPipeline> gaussianPipeline;
 		std::unique_ptr<ComputePipeline> gaussianComputePipeline;
+		std::unique_ptr<ComputePipeline> compactScanPipeline;
+		std::unique_ptr<ComputePipeline> compactScatterPipeline;
+		std::unique_ptr<ComputePipeline> depthOrderKeysPipeline;
+		std::unique_ptr<ComputePipeline> depthOrderRefinePipeline;
+		std::unique_ptr<ComputePipeline> depthOrderFlagsPipeline;
 		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<GpuRadixSort> radixSort;
+		// Only with GaussianSortMode::Incremental
+		std::unique_ptr<GpuCompact> depthOrderCompact;
+		// Only with GaussianRenderPath::TileCompute
+		std::unique_ptr<GaussianTileRasterizer> tileRasterizer;
+
+		// Declared last so its thread stops before the state its source reads from is destroyed
+		std::unique_ptr<GaussianStreamer> streamer;
 	};
 }
\ No newline at end of file
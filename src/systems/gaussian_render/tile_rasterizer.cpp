@@ -0,0 +1,411 @@
+#include "tile_rasterizer.hpp"
+#include "vr_swap_chain.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+
+namespace vr {
+
+    // Must match the push block in shaders/tile_raster.glsl
+    struct TilePushConstantData {
+        uint32_t tileCount[2];
+        uint32_t viewport[2];
+        uint32_t splatCount;
+        uint32_t instanceCapacity;
+    };
+
+    GaussianTileRasterizer::GaussianTileRasterizer(VrDevice& device, VkRenderPass renderPass, uint32_t maxModels)
+        : vrDevice{ device } {
+        instanceSort = std::make_unique<GpuRadixSort>(vrDevice, maxModels, 2);
+        createSetLayouts(maxModels);
+        createPipelineLayouts();
+        createPipelines(renderPass);
+        frameImages.resize(VrSwapChain::MAX_FRAMES_IN_FLIGHT);
+    }
+
+    GaussianTileRasterizer::~GaussianTileRasterizer() {
+        for (auto& frameImage : frameImages) {
+            destroyFrameImage(frameImage);
+        }
+        vkDestroyPipelineLayout(vrDevice.device(), compositePipelineLayout, nullptr);
+        vkDestroyPipelineLayout(vrDevice.device(), tilePipelineLayout, nullptr);
+    }
+
+    void GaussianTileRasterizer::createSetLayouts(uint32_t maxModels) {
+        tileSetLayout = VrDescriptorSetLayout::Builder(vrDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+        const uint32_t tileSetCount = maxModels * VrSwapChain::MAX_FRAMES_IN_FLIGHT;
+        tilePool = VrDescriptorPool::Builder(vrDevice)
+            .setMaxSets(tileSetCount)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, tileSetCount * 5)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, tileSetCount)
+            .build();
+
+        compositeSetLayout = VrDescriptorSetLayout::Builder(vrDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+
+        compositePool = VrDescriptorPool::Builder(vrDevice)
+            .setMaxSets(VrSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VrSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+    }
+
+    void GaussianTileRasterizer::createPipelineLayouts() {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(TilePushConstantData);
+
+        VkDescriptorSetLayout tileLayout = tileSetLayout->getDescriptorSetLayout();
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &tileLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(vrDevice.device(), &pipelineLayoutInfo, nullptr, &tilePipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create tile pipeline layout");
+        }
+
+        VkDescriptorSetLayout compositeLayout = compositeSetLayout->getDescriptorSetLayout();
+        pipelineLayoutInfo.pSetLayouts = &compositeLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+        if (vkCreatePipelineLayout(vrDevice.device(), &pipelineLayoutInfo, nullptr, &compositePipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create tile composite pipeline layout");
+        }
+    }
+
+    void GaussianTileRasterizer::createPipelines(VkRenderPass renderPass) {
+        PipelineConfigInfo computeConfig{};
+        computeConfig.pipelineLayout = tilePipelineLayout;
+        duplicatePipeline = std::make_unique<ComputePipeline>(vrDevice, "tile_duplicate.comp", computeConfig);
+        rangesPipeline = std::make_unique<ComputePipeline>(vrDevice, "tile_ranges.comp", computeConfig);
+        renderPipeline = std::make_unique<ComputePipeline>(vrDevice, "tile_render.comp", computeConfig);
+
+        // Premultiplied "over" onto the swap chain image, which the tile image already is
+        PipelineConfigInfo compositeConfig{};
+        VrPipeline::defaultPipelineConfigInfo(compositeConfig);
+        compositeConfig.renderPass = renderPass;
+        compositeConfig.pipelineLayout = compositePipelineLayout;
+        compositeConfig.colorBlendAttachment.blendEnable = VK_TRUE;
+        compositeConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        compositeConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        compositeConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        compositeConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        compositeConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+        compositeConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+
+        compositePipeline = std::make_unique<VrPipeline>(
+            vrDevice,
+            "tile_composite.vert",
+            "tile_composite.frag",
+            compositeConfig,
+            std::vector<VkVertexInputBindingDescription>{},
+            std::vector<VkVertexInputAttributeDescription>{}
+        );
+    }
+
+    void GaussianTileRasterizer::addModel(const GaussianModel& model, const std::vector<std::unique_ptr<Buffer>>& projectedSplats) {
+        ModelTiles tiles{};
+        tiles.model = &model;
+        tiles.instanceCapacity = static_cast<uint32_t>(std::min<uint64_t>(
+            static_cast<uint64_t>(std::max(model.getCapacity(), 1u)) * INSTANCES_PER_SPLAT,
+            MAX_INSTANCES));
+        tiles.instances = instanceSort->createBuffers(tiles.instanceCapacity);
+
+        auto keysInfo = tiles.instances->keys->descriptorInfo();
+        auto splatsInfo = tiles.instances->values->descriptorInfo();
+        auto countInfo = tiles.instances->count->descriptorInfo();
+
+        for (int i = 0; i < VrSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            auto projectedInfo = projectedSplats[i]->descriptorInfo();
+            VkDescriptorSet descriptorSet;
+            if (!VrDescriptorWriter(*tileSetLayout, *tilePool)
+                .writeBuffer(0, &projectedInfo)
+                .writeBuffer(1, &keysInfo)
+                .writeBuffer(2, &splatsInfo)
+                .writeBuffer(3, &countInfo)
+                .build(descriptorSet)) {
+                throw std::runtime_error("Failed to allocate tile rasterizer descriptor set");
+            }
+            tiles.descriptorSets.push_back(descriptorSet);
+        }
+
+        // Otherwise written by the first resize
+        if (extent.width != 0) {
+            tiles.tileRanges = std::make_unique<Buffer>(
+                vrDevice,
+                sizeof(uint32_t) * 2,
+                tileCount(),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            writeExtentBindings(tiles);
+        }
+
+        modelTiles.push_back(std::move(tiles));
+    }
+
+    GaussianTileRasterizer::ModelTiles& GaussianTileRasterizer::getModelTiles(const GaussianModel& model) {
+        for (auto& tiles : modelTiles) {
+            if (tiles.model == &model) {
+                return tiles;
+            }
+        }
+        throw std::runtime_error("Gaussian model was not added to the tile rasterizer");
+    }
+
+    void GaussianTileRasterizer::resize(VkExtent2D newExtent) {
+        if (newExtent.width == extent.width && newExtent.height == extent.height) {
+            return;
+        }
+
+        // Rare enough that waiting beats keeping old images alive until their frames retire
+        vkDeviceWaitIdle(vrDevice.device());
+
+        extent = newExtent;
+        tileCountX = (extent.width + TILE_SIZE - 1) / TILE_SIZE;
+        tileCountY = (extent.height + TILE_SIZE - 1) / TILE_SIZE;
+
+        for (auto& frameImage : frameImages) {
+            destroyFrameImage(frameImage);
+            createFrameImage(frameImage);
+        }
+
+        for (auto& tiles : modelTiles) {
+            tiles.tileRanges = std::make_unique<Buffer>(
+                vrDevice,
+                sizeof(uint32_t) * 2,
+                tileCount(),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            writeExtentBindings(tiles);
+        }
+    }
+
+    void GaussianTileRasterizer::createFrameImage(FrameImage& frameImage) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = extent.width;
+        imageInfo.extent.height = extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = IMAGE_FORMAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.flags = 0;
+
+        // Rasterized on the compute queue and read on the graphics queue
+        const std::vector<uint32_t>& sharedQueueFamilies = vrDevice.getSharedQueueFamilies();
+        if (sharedQueueFamilies.size() > 1) {
+            imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+            imageInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+        } else {
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
+
+        vrDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frameImage.image, frameImage.memory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = frameImage.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = IMAGE_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(vrDevice.device(), &viewInfo, nullptr, &frameImage.view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create tile image view");
+        }
+
+        VkDescriptorImageInfo descriptorInfo{ VK_NULL_HANDLE, frameImage.view, VK_IMAGE_LAYOUT_GENERAL };
+        if (frameImage.compositeSet == VK_NULL_HANDLE) {
+            if (!VrDescriptorWriter(*compositeSetLayout, *compositePool)
+                .writeImage(0, &descriptorInfo)
+                .build(frameImage.compositeSet)) {
+                throw std::runtime_error("Failed to allocate tile composite descriptor set");
+            }
+        }
+        else {
+            VrDescriptorWriter(*compositeSetLayout, *compositePool)
+                .writeImage(0, &descriptorInfo)
+                .overwrite(frameImage.compositeSet);
+        }
+    }
+
+    void GaussianTileRasterizer::destroyFrameImage(FrameImage& frameImage) {
+        if (frameImage.image == VK_NULL_HANDLE) {
+            return;
+        }
+        vkDestroyImageView(vrDevice.device(), frameImage.view, nullptr);
+        vkDestroyImage(vrDevice.device(), frameImage.image, nullptr);
+        vkFreeMemory(vrDevice.device(), frameImage.memory, nullptr);
+        frameImage.view = VK_NULL_HANDLE;
+        frameImage.image = VK_NULL_HANDLE;
+        frameImage.memory = VK_NULL_HANDLE;
+    }
+
+    void GaussianTileRasterizer::writeExtentBindings(ModelTiles& tiles) {
+        auto rangesInfo = tiles.tileRanges->descriptorInfo();
+        for (size_t i = 0; i < tiles.descriptorSets.size(); i++) {
+            VkDescriptorImageInfo imageInfo{ VK_NULL_HANDLE, frameImages[i].view, VK_IMAGE_LAYOUT_GENERAL };
+            VrDescriptorWriter(*tileSetLayout, *tilePool)
+                .writeBuffer(4, &rangesInfo)
+                .writeImage(5, &imageInfo)
+                .overwrite(tiles.descriptorSets[i]);
+        }
+    }
+
+    void GaussianTileRasterizer::beginFrame(FrameInfo& frameInfo) {
+        assert(frameInfo.extent.width == extent.width && frameInfo.extent.height == extent.height &&
+            "Tile rasterizer was not resized to the frame's extent");
+
+        VkCommandBuffer commandBuffer = frameInfo.computeCommandBuffer;
+
+        // The previous contents are not needed, and acquireNextImage waited for graphicsTimeline
+        // to reach this slot's previous value, which covers the composite that last read its image
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = frameImages[frameInfo.frameIndex].image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            1,
+            &barrier);
+
+        VkClearColorValue clearColor{};
+        vkCmdClearColorImage(commandBuffer, barrier.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &barrier.subresourceRange);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            1,
+            &barrier);
+    }
+
+    void GaussianTileRasterizer::rasterize(FrameInfo& frameInfo, const GaussianModel& model) {
+        assert(extent.width != 0 && "beginFrame must be recorded before rasterize");
+
+        VkCommandBuffer commandBuffer = frameInfo.computeCommandBuffer;
+        ModelTiles& tiles = getModelTiles(model);
+
+        // The instance buffers are shared by all frames in flight; this orders the reset after
+        // the previous frame's tile passes, which ran earlier on the same queue
+        memoryBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT);
+        vkCmdFillBuffer(commandBuffer, tiles.instances->count->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+        vkCmdFillBuffer(commandBuffer, tiles.tileRanges->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+        memoryBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        TilePushConstantData push{};
+        push.tileCount[0] = tileCountX;
+        push.tileCount[1] = tileCountY;
+        push.viewport[0] = extent.width;
+        push.viewport[1] = extent.height;
+        push.splatCount = model.getGaussianCount();
+        push.instanceCapacity = tiles.instanceCapacity;
+
+        auto bindTilePipeline = [&](ComputePipeline& pipeline) {
+            pipeline.bind(commandBuffer);
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                tilePipelineLayout,
+                0,
+                1,
+                &tiles.descriptorSets[frameInfo.frameIndex],
+                0,
+                nullptr);
+            vkCmdPushConstants(commandBuffer, tilePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        };
+
+        bindTilePipeline(*duplicatePipeline);
+        vkCmdDispatch(commandBuffer, (push.splatCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        computeBarrier(commandBuffer);
+
+        // Only the bits a tile index can use are sorted above the 32 depth bits
+        const uint32_t tileBits = std::max<uint32_t>(std::bit_width(tileCount() - 1), 1);
+        instanceSort->sortIndirect(commandBuffer, *tiles.instances, tiles.instanceCapacity, 32 + tileBits);
+
+        bindTilePipeline(*rangesPipeline);
+        vkCmdDispatch(
+            commandBuffer,
+            std::min(RANGE_WORKGROUP_COUNT, (tiles.instanceCapacity + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE),
+            1,
+            1);
+        computeBarrier(commandBuffer);
+
+        bindTilePipeline(*renderPipeline);
+        vkCmdDispatch(commandBuffer, tileCountX, tileCountY, 1);
+        // The next model blends over this one's output
+        computeBarrier(commandBuffer);
+    }
+
+    void GaussianTileRasterizer::composite(FrameInfo& frameInfo) {
+        // The image reaches the fragment stage through the semaphore the graphics submit waits on
+        compositePipeline->bind(frameInfo.commandBuffer);
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            compositePipelineLayout,
+            0,
+            1,
+            &frameImages[frameInfo.frameIndex].compositeSet,
+            0,
+            nullptr);
+        vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "vr_device.hpp"
+#include "frame_info.hpp"
+#include "buffer.hpp"
+#include "descriptors.hpp"
+#include "gaussian_model.hpp"
+#include "./pipelines/vr_pipeline.hpp"
+#include "./pipelines/compute_pipeline.hpp"
+#include "./pipelines/gpu_radix_sort.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vr {
+
+	// Compute-only splat renderer. Each visible splat is duplicated once per 16x16 screen tile it
+	// overlaps, the duplicates are sorted by (tile, view depth), and every tile then blends its
+	// run front to back in shared memory until its pixels are opaque. The result lands in a
+	// storage image per frame that composite() draws into the swap chain pass.
+	class GaussianTileRasterizer {
+	public:
+		// Must match TILE_SIZE in shaders/tile_raster.glsl
+		static constexpr uint32_t TILE_SIZE = 16;
+		// Must match local_size_x in shaders/tile_duplicate.comp and shaders/tile_ranges.comp
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+		// tile_ranges.comp strides over the instances with at most this many workgroups
+		static constexpr uint32_t RANGE_WORKGROUP_COUNT = 1024;
+		// Tile instances stored per splat of capacity, up to MAX_INSTANCES per model. Instances
+		// past the limit are dropped for that frame
+		static constexpr uint32_t INSTANCES_PER_SPLAT = 4;
+		static constexpr uint32_t MAX_INSTANCES = 1u << 24;
+		// Must match the format qualifier of tileImage in the tile shaders
+		static constexpr VkFormat IMAGE_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		GaussianTileRasterizer(VrDevice& device, VkRenderPass renderPass, uint32_t maxModels);
+		~GaussianTileRasterizer();
+
+		GaussianTileRasterizer(const GaussianTileRasterizer&) = delete;
+		GaussianTileRasterizer& operator=(const GaussianTileRasterizer&) = delete;
+
+		// Allocates model's instance storage. projectedSplats holds preprocess.comp's output for
+		// each frame in flight
+		void addModel(const GaussianModel& model, const std::vector<std::unique_ptr<Buffer>>& projectedSplats);
+
+		// Matches the frame images and tile ranges to the swap chain extent. A new extent waits
+		// for the device to go idle and recreates them, so this runs on the main thread before
+		// the frame's recording starts
+		void resize(VkExtent2D newExtent);
+		// Records into the compute command buffer: clears this frame's image. resize must already
+		// have matched the images to frameInfo.extent
+		void beginFrame(FrameInfo& frameInfo);
+		// Records model's tile passes into the compute command buffer. Its preprocess output
+		// must already be visible to compute shaders
+		void rasterize(FrameInfo& frameInfo, const GaussianModel& model);
+		// Records the composite of this frame's image into the swap chain pass
+		void composite(FrameInfo& frameInfo);
+
+	private:
+		struct FrameImage {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDescriptorSet compositeSet = VK_NULL_HANDLE;
+		};
+
+		struct ModelTiles {
+			const GaussianModel* model;
+			uint32_t instanceCapacity;
+			// Keys are (view depth, tile) pairs, values splat indices
+			std::unique_ptr<GpuRadixSort::Buffers> instances;
+			std::unique_ptr<Buffer> tileRanges;
+			// One per frame in flight
+			std::vector<VkDescriptorSet> descriptorSets;
+		};
+
+		void createSetLayouts(uint32_t maxModels);
+		void createPipelineLayouts();
+		void createPipelines(VkRenderPass renderPass);
+
+		void createFrameImage(FrameImage& frameImage);
+		void destroyFrameImage(FrameImage& frameImage);
+		// Points model's sets at the current tile ranges and frame images
+		void writeExtentBindings(ModelTiles& tiles);
+		ModelTiles& getModelTiles(const GaussianModel& model);
+		uint32_t tileCount() const { return tileCountX * tileCountY; }
+
+		VrDevice& vrDevice;
+		std::unique_ptr<GpuRadixSort> instanceSort;
+
+		std::unique_ptr<VrDescriptorSetLayout> tileSetLayout;
+		std::unique_ptr<VrDescriptorPool> tilePool;
+		std::unique_ptr<VrDescriptorSetLayout> compositeSetLayout;
+		std::unique_ptr<VrDescriptorPool> compositePool;
+		VkPipelineLayout tilePipelineLayout;
+		VkPipelineLayout compositePipelineLayout;
+
+		std::unique_ptr<ComputePipeline> duplicatePipeline;
+		std::unique_ptr<ComputePipeline> rangesPipeline;
+		std::unique_ptr<ComputePipeline> renderPipeline;
+		std::unique_ptr<VrPipeline> compositePipeline;
+
+		VkExtent2D extent{ 0, 0 };
+		uint32_t tileCountX = 0;
+		uint32_t tileCountY = 0;
+		std::vector<FrameImage> frameImages;
+		std::vector<ModelTiles> modelTiles;
+	};
+}
@@ -62,8 +62,8 @@ namespace vr {
 		pipelineConfig.pipelineLayout = pipelineLayout;
 		vrPipeline = std::make_unique<VrPipeline>(
 			vrDevice,
-			"../../../shaders/simple_shader.vert.spv",
-			"../../../shaders/simple_shader.frag.spv",
+			"simple_shader.vert",
+			"simple_shader.frag",
 			pipelineConfig,
 			bindingDescription,
 			attributeDescription
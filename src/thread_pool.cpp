@@ -0,0 +1,151 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace vr {
+
+	ThreadPool::ThreadPool(uint32_t threadCount) {
+		threadCount = std::max(threadCount, 1u);
+
+		for (uint32_t i = 0; i < threadCount; i++) {
+			queues.push_back(std::make_unique<WorkerQueue>());
+		}
+
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers.emplace_back([this, i] { workerLoop(i); });
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{ wakeMutex };
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> task) {
+		uint32_t index = nextQueue.fetch_add(1, std::memory_order_relaxed) % getThreadCount();
+		// Counted before it is queued, so a worker that pops it can never take the count below zero
+		{
+			std::lock_guard<std::mutex> lock{ wakeMutex };
+			queuedTasks.fetch_add(1, std::memory_order_release);
+		}
+		{
+			std::lock_guard<std::mutex> lock{ queues[index]->mutex };
+			queues[index]->tasks.push_back(std::move(task));
+		}
+		wakeCondition.notify_one();
+	}
+
+	void ThreadPool::parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& fn) {
+		if (count == 0) {
+			return;
+		}
+		chunkSize = std::max<size_t>(chunkSize, 1);
+		size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+		if (chunkCount == 1) {
+			fn(0, count);
+			return;
+		}
+
+		// Chunks are claimed from a shared counter, so the tasks below are just "help out" tickets
+		// and a worker that finishes early keeps taking chunks instead of idling.
+		struct SharedState {
+			std::atomic<size_t> nextChunk{ 0 };
+			std::atomic<size_t> remainingChunks{ 0 };
+			std::mutex doneMutex;
+			std::condition_variable doneCondition;
+			std::exception_ptr exception;
+		};
+		auto state = std::make_shared<SharedState>();
+		state->remainingChunks = chunkCount;
+
+		auto runChunks = [state, count, chunkSize, chunkCount, &fn] {
+			for (;;) {
+				size_t chunk = state->nextChunk.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= chunkCount) {
+					return;
+				}
+
+				size_t begin = chunk * chunkSize;
+				size_t end = std::min(begin + chunkSize, count);
+				try {
+					fn(begin, end);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock{ state->doneMutex };
+					if (!state->exception) {
+						state->exception = std::current_exception();
+					}
+				}
+
+				if (state->remainingChunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					std::lock_guard<std::mutex> lock{ state->doneMutex };
+					state->doneCondition.notify_all();
+				}
+			}
+		};
+
+		size_t helpers = std::min<size_t>(getThreadCount(), chunkCount - 1);
+		for (size_t i = 0; i < helpers; i++) {
+			submit(runChunks);
+		}
+
+		runChunks();
+
+		std::unique_lock<std::mutex> lock{ state->doneMutex };
+		state->doneCondition.wait(lock, [&state] { return state->remainingChunks.load(std::memory_order_acquire) == 0; });
+
+		if (state->exception) {
+			std::rethrow_exception(state->exception);
+		}
+	}
+
+	bool ThreadPool::popTask(uint32_t index, std::function<void()>& task) {
+		{
+			WorkerQueue& own = *queues[index];
+			std::lock_guard<std::mutex> lock{ own.mutex };
+			if (!own.tasks.empty()) {
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				return true;
+			}
+		}
+
+		for (uint32_t offset = 1; offset < getThreadCount(); offset++) {
+			WorkerQueue& victim = *queues[(index + offset) % getThreadCount()];
+			std::lock_guard<std::mutex> lock{ victim.mutex };
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void ThreadPool::workerLoop(uint32_t index) {
+		for (;;) {
+			std::function<void()> task;
+			if (popTask(index, task)) {
+				queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+				task();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{ wakeMutex };
+			wakeCondition.wait(lock, [this] { return stopping || queuedTasks.load(std::memory_order_acquire) > 0; });
+			if (stopping && queuedTasks.load(std::memory_order_acquire) == 0) {
+				return;
+			}
+		}
+	}
+}
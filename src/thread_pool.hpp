@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vr {
+
+	// Fixed-size pool of worker threads. Each worker owns a task deque: it pops its own work
+	// from the back and steals from the front of other workers' deques when it runs dry.
+	class ThreadPool {
+	public:
+		explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+		void submit(std::function<void()> task);
+
+		// Calls fn(begin, end) for consecutive chunks of [0, count) and blocks until every chunk
+		// has run. The calling thread executes chunks too. The first exception thrown by fn is
+		// rethrown once all chunks have finished.
+		void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& fn);
+
+	private:
+		struct WorkerQueue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void workerLoop(uint32_t index);
+		bool popTask(uint32_t index, std::function<void()>& task);
+
+		std::vector<std::unique_ptr<WorkerQueue>> queues;
+		std::vector<std::thread> workers;
+
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<size_t> queuedTasks{ 0 };
+		std::atomic<uint32_t> nextQueue{ 0 };
+		bool stopping = false;
+	};
+}
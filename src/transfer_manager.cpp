@@ -0,0 +1,185 @@
+#include "transfer_manager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vr {
+
+	TransferManager::TransferManager(VrDevice& device) : vrDevice{ device } {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = vrDevice.transferFamily();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(vrDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create transfer command pool");
+		}
+
+		timeline = vrDevice.createTimelineSemaphore();
+
+		stagingRing = std::make_unique<Buffer>(
+			vrDevice,
+			STAGING_RING_SIZE,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		);
+		stagingRing->map();
+	}
+
+	TransferManager::~TransferManager() {
+		// Staging memory and command buffers may still be in use by the last batch
+		vrDevice.waitForTimeline(timeline, submittedValue);
+		stagingRing.reset();
+
+		vkDestroySemaphore(vrDevice.device(), timeline, nullptr);
+		vkDestroyCommandPool(vrDevice.device(), commandPool, nullptr);
+	}
+
+	TransferManager::StagingAllocation TransferManager::allocateStaging(VkDeviceSize size) {
+		if (size > MAX_STAGING_ALLOCATION) {
+			throw std::runtime_error("Staging allocation is larger than the staging ring allows");
+		}
+
+		uint64_t begin = (stagingHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		// Allocations never wrap; the bytes left at the end of the ring are skipped instead
+		if (begin % STAGING_RING_SIZE + size > STAGING_RING_SIZE) {
+			begin += STAGING_RING_SIZE - begin % STAGING_RING_SIZE;
+		}
+		const uint64_t end = begin + size;
+
+		if (end - stagingTail > STAGING_RING_SIZE) {
+			retireStaging(getCompletedValue());
+		}
+		while (end - stagingTail > STAGING_RING_SIZE) {
+			// The rest of the ring belongs to the unsubmitted batch, which has to go first
+			if (stagingRegions.empty()) {
+				if (recording == VK_NULL_HANDLE) {
+					// Nothing copies from it
+					stagingTail = stagingHead;
+					break;
+				}
+				submit();
+			}
+			wait(stagingRegions.front().value);
+		}
+
+		stagingHead = end;
+		VkDeviceSize offset = begin % STAGING_RING_SIZE;
+		return { static_cast<char*>(stagingRing->getMappedMemory()) + offset, stagingRing->getBuffer(), offset, size };
+	}
+
+	void TransferManager::retireStaging(uint64_t completedValue) {
+		while (!stagingRegions.empty() && stagingRegions.front().value <= completedValue) {
+			stagingTail = stagingRegions.front().end;
+			stagingRegions.pop_front();
+		}
+	}
+
+	uint64_t TransferManager::getCompletedValue() {
+		uint64_t completedValue;
+		vkGetSemaphoreCounterValue(vrDevice.device(), timeline, &completedValue);
+		return completedValue;
+	}
+
+	void TransferManager::copy(const StagingAllocation& staging, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size) {
+		VkBufferCopy region{};
+		region.srcOffset = staging.offset;
+		region.dstOffset = dstOffset;
+		region.size = size == VK_WHOLE_SIZE ? staging.size : size;
+		if (region.size == 0) {
+			return;
+		}
+		vkCmdCopyBuffer(getCommandBuffer(), staging.buffer, dstBuffer, 1, &region);
+	}
+
+	void TransferManager::upload(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+		for (VkDeviceSize offset = 0; offset < size; offset += MAX_STAGING_ALLOCATION) {
+			VkDeviceSize pieceSize = std::min(size - offset, MAX_STAGING_ALLOCATION);
+			StagingAllocation staging = allocateStaging(pieceSize);
+			std::memcpy(staging.mapped, static_cast<const char*>(data) + offset, pieceSize);
+			copy(staging, dstBuffer, dstOffset + offset);
+		}
+	}
+
+	VkCommandBuffer TransferManager::getCommandBuffer() {
+		if (recording != VK_NULL_HANDLE) {
+			return recording;
+		}
+
+		const uint64_t completedValue = getCompletedValue();
+		auto batch = std::find_if(batches.begin(), batches.end(), [&](const Batch& batch) {
+			return batch.value <= completedValue;
+		});
+		if (batch != batches.end()) {
+			recording = batch->commandBuffer;
+			batches.erase(batch);
+			vkResetCommandBuffer(recording, 0);
+		}
+		else {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(vrDevice.device(), &allocInfo, &recording) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate transfer command buffer");
+			}
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(recording, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin transfer command buffer");
+		}
+		return recording;
+	}
+
+	uint64_t TransferManager::submit() {
+		if (recording == VK_NULL_HANDLE) {
+			return submittedValue;
+		}
+
+		if (vkEndCommandBuffer(recording) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record transfer command buffer");
+		}
+
+		uint64_t signalValue = submittedValue + 1;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &recording;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline;
+
+		if (vkQueueSubmit(vrDevice.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit transfer command buffer");
+		}
+
+		batches.push_back({ recording, signalValue });
+		stagingRegions.push_back({ stagingHead, signalValue });
+		recording = VK_NULL_HANDLE;
+		submittedValue = signalValue;
+		return submittedValue;
+	}
+
+	bool TransferManager::isComplete(uint64_t value) {
+		return getCompletedValue() >= value;
+	}
+
+	void TransferManager::wait(uint64_t value) {
+		vrDevice.waitForTimeline(timeline, value);
+		retireStaging(value);
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "vr_device.hpp"
+#include "buffer.hpp"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace vr {
+
+	// Batches buffer uploads into one submission on the device's transfer queue. Copies are
+	// recorded as they are requested and only reach the GPU on submit(), which returns a timeline
+	// value the caller waits on before the destination buffers are used, so loading many assets
+	// costs a single sync. Staging memory comes from a fixed-size, persistently mapped ring whose
+	// regions are retired by timeline value, so peak staging memory does not depend on how much
+	// is uploaded: when the ring is full the pending copies are submitted and the oldest region
+	// is waited for. Used from one thread at a time.
+	class TransferManager {
+	public:
+		static constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+		// Largest single staging allocation. Half the ring, so the next piece of a large upload
+		// can be written while the previous one is copied
+		static constexpr VkDeviceSize MAX_STAGING_ALLOCATION = STAGING_RING_SIZE / 2;
+		// Alignment of staging allocations, enough for every element type uploaded
+		static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+		// Mapped, host-coherent staging memory. Written by the caller, then copied by copy()
+		struct StagingAllocation {
+			void* mapped;
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			VkDeviceSize size;
+
+			// subSize bytes starting subOffset bytes in, for several streams staged in one allocation
+			StagingAllocation subrange(VkDeviceSize subOffset, VkDeviceSize subSize) const {
+				return { static_cast<char*>(mapped) + subOffset, buffer, offset + subOffset, subSize };
+			}
+		};
+
+		TransferManager(VrDevice& device);
+		~TransferManager();
+
+		TransferManager(const TransferManager&) = delete;
+		TransferManager& operator=(const TransferManager&) = delete;
+
+		// Ring memory for up to MAX_STAGING_ALLOCATION bytes. The copies from it must be recorded
+		// before the next allocation, which may submit the batch to make room
+		StagingAllocation allocateStaging(VkDeviceSize size);
+		// Records a copy of size bytes (the whole allocation by default) from staging to dstBuffer
+		void copy(const StagingAllocation& staging, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+		// Copies data into staging and records its copy to dstBuffer, in pieces when it is larger
+		// than one allocation. data may be freed on return
+		void upload(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+
+		// Submits the copies recorded so far and returns the value the timeline reaches when they
+		// are done. With nothing recorded, returns the value of the last submission
+		uint64_t submit();
+		bool isComplete(uint64_t value);
+		void wait(uint64_t value);
+		// Submits and waits for everything recorded so far
+		void flush() { wait(submit()); }
+
+	private:
+		// Ring bytes up to end (counted since creation) are free once value completes
+		struct StagingRegion {
+			uint64_t end;
+			uint64_t value;
+		};
+
+		struct Batch {
+			VkCommandBuffer commandBuffer;
+			uint64_t value;
+		};
+
+		VkCommandBuffer getCommandBuffer();
+		// Advances the ring tail past regions whose batches have completed
+		void retireStaging(uint64_t completedValue);
+		uint64_t getCompletedValue();
+
+		VrDevice& vrDevice;
+		VkCommandPool commandPool;
+		VkSemaphore timeline;
+		uint64_t submittedValue = 0;
+
+		VkCommandBuffer recording = VK_NULL_HANDLE;
+		std::vector<Batch> batches;
+
+		std::unique_ptr<Buffer> stagingRing;
+		// Bytes allocated and retired since creation; the ring offset is their value modulo its size
+		uint64_t stagingHead = 0;
+		uint64_t stagingTail = 0;
+		std::deque<StagingRegion> stagingRegions;
+	};
+}
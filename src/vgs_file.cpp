@@ -0,0 +1,174 @@
+#include "vgs_file.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace vr {
+
+	namespace {
+		uint64_t alignUp(uint64_t value, uint64_t alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		void sourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& timestamp) {
+			size = static_cast<uint64_t>(std::filesystem::file_size(sourcePath));
+			timestamp = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath).time_since_epoch().count());
+		}
+	}
+
+	// *************** Writer *********************
+
+	VgsWriter::VgsWriter(const std::string& filepath, const std::string& sourcePath, uint64_t gaussianCount, uint32_t shDegree)
+		: filepath{ filepath },
+		tempFilepath{ filepath + ".tmp" },
+		sourcePath{ sourcePath },
+		gaussianCount{ gaussianCount },
+		shDegree{ shDegree } {
+		file.open(tempFilepath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error("Could not create scene cache: " + tempFilepath);
+		}
+
+		sections.push_back({ static_cast<uint32_t>(VgsSectionType::Positions), sizeof(GaussianModel::PositionOpacity), 0, 0 });
+		sections.push_back({ static_cast<uint32_t>(VgsSectionType::Covariances), sizeof(GaussianModel::Covariance), 0, 0 });
+		sections.push_back({ static_cast<uint32_t>(VgsSectionType::SphericalHarmonics), static_cast<uint32_t>(shCoefficientCount(shDegree) * sizeof(float)), 0, 0 });
+
+		uint64_t offset = sizeof(VgsHeader) + sections.size() * sizeof(VgsSectionEntry);
+		for (auto& section : sections) {
+			section.offset = alignUp(offset, VGS_SECTION_ALIGNMENT);
+			section.size = section.stride * gaussianCount;
+			offset = section.offset + section.size;
+		}
+	}
+
+	VgsWriter::~VgsWriter() {
+		if (!finished) {
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(tempFilepath, error);
+		}
+	}
+
+	void VgsWriter::append(const GaussianModel::SplatStreams& src, size_t count) {
+		if (src.shCoefficientCount != shCoefficientCount(shDegree)) {
+			throw std::runtime_error("SH degree does not match scene cache: " + filepath);
+		}
+		if (writtenCount + count > gaussianCount) {
+			throw std::runtime_error("Too many gaussians written to scene cache: " + filepath);
+		}
+
+		writeSection(sections[0], src.positions, count);
+		writeSection(sections[1], src.covariances, count);
+		writeSection(sections[2], src.sh, count);
+		writtenCount += count;
+	}
+
+	void VgsWriter::writeSection(const VgsSectionEntry& section, const void* data, size_t count) {
+		file.seekp(static_cast<std::streamoff>(section.offset + writtenCount * section.stride));
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(count * section.stride));
+	}
+
+	void VgsWriter::finish() {
+		if (writtenCount != gaussianCount) {
+			throw std::runtime_error("Scene cache is incomplete: " + filepath);
+		}
+
+		VgsHeader header{};
+		std::memcpy(header.magic, VGS_MAGIC, sizeof(header.magic));
+		header.version = VGS_VERSION;
+		header.gaussianCount = gaussianCount;
+		header.sectionCount = static_cast<uint32_t>(sections.size());
+		header.shDegree = shDegree;
+		sourceStamp(sourcePath, header.sourceSize, header.sourceTimestamp);
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(sections.data()), sections.size() * sizeof(VgsSectionEntry));
+		file.close();
+
+		if (!file) {
+			throw std::runtime_error("Failed to write scene cache: " + tempFilepath);
+		}
+
+		std::filesystem::remove(filepath);
+		std::filesystem::rename(tempFilepath, filepath);
+		finished = true;
+	}
+
+	// *************** Reader *********************
+
+	VgsFile::VgsFile(const std::string& filepath) : mappedFile{ filepath } {
+		if (mappedFile.size() < sizeof(VgsHeader)) {
+			throw std::runtime_error("Scene cache is truncated: " + filepath);
+		}
+
+		std::memcpy(&header, mappedFile.data(), sizeof(header));
+
+		if (std::memcmp(header.magic, VGS_MAGIC, sizeof(header.magic)) != 0) {
+			throw std::runtime_error("Not a scene cache: " + filepath);
+		}
+		if (header.version != VGS_VERSION) {
+			throw std::runtime_error("Unsupported scene cache version " + std::to_string(header.version) + ": " + filepath);
+		}
+
+		if (header.shDegree > MAX_SH_DEGREE) {
+			throw std::runtime_error("Scene cache has an unsupported SH degree: " + filepath);
+		}
+
+		uint64_t tableEnd = sizeof(VgsHeader) + static_cast<uint64_t>(header.sectionCount) * sizeof(VgsSectionEntry);
+		if (tableEnd > mappedFile.size()) {
+			throw std::runtime_error("Scene cache is truncated: " + filepath);
+		}
+
+		positions = reinterpret_cast<const GaussianModel::PositionOpacity*>(
+			findSection(VgsSectionType::Positions, sizeof(GaussianModel::PositionOpacity)));
+		covariances = reinterpret_cast<const GaussianModel::Covariance*>(
+			findSection(VgsSectionType::Covariances, sizeof(GaussianModel::Covariance)));
+		sh = reinterpret_cast<const float*>(
+			findSection(VgsSectionType::SphericalHarmonics, static_cast<uint32_t>(shCoefficientCount(header.shDegree) * sizeof(float))));
+
+		if (!positions || !covariances || !sh) {
+			throw std::runtime_error("Scene cache is missing sections or has a different layout: " + filepath);
+		}
+	}
+
+	const char* VgsFile::findSection(VgsSectionType type, uint32_t stride) const {
+		const char* table = mappedFile.data() + sizeof(VgsHeader);
+
+		for (uint32_t i = 0; i < header.sectionCount; i++) {
+			VgsSectionEntry section;
+			std::memcpy(&section, table + i * sizeof(VgsSectionEntry), sizeof(section));
+
+			if (section.type != static_cast<uint32_t>(type)) {
+				continue;
+			}
+			if (section.stride != stride ||
+				section.size != header.gaussianCount * stride ||
+				section.offset % VGS_SECTION_ALIGNMENT != 0 ||
+				section.offset + section.size > mappedFile.size()) {
+				return nullptr;
+			}
+			return mappedFile.data() + section.offset;
+		}
+
+		return nullptr;
+	}
+
+	void VgsFile::copyTo(size_t first, size_t count, const GaussianModel::SplatStreams& dst) const {
+		std::memcpy(dst.positions, positions + first, count * sizeof(GaussianModel::PositionOpacity));
+		std::memcpy(dst.covariances, covariances + first, count * sizeof(GaussianModel::Covariance));
+		const uint32_t coefficientCount = shCoefficientCount(header.shDegree);
+		if (dst.shCoefficientCount != coefficientCount) {
+			throw std::runtime_error("Scene cache copy target has a different SH degree");
+		}
+		std::memcpy(dst.sh, sh + first * coefficientCount, count * coefficientCount * sizeof(float));
+	}
+
+	bool VgsFile::matchesSource(const std::string& sourcePath) const {
+		uint64_t size;
+		int64_t timestamp;
+		sourceStamp(sourcePath, size, timestamp);
+		return size == header.sourceSize && timestamp == header.sourceTimestamp;
+	}
+}
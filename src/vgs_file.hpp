@@ -0,0 +1,102 @@
+#pragma once
+
+#include "gaussian_model.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vr {
+
+	// Native scene cache (.vgs). Splats are stored already activated and split into the same
+	// streams GaussianModel uploads, so a cached scene is mapped and copied straight into
+	// staging memory with no parsing or per-splat math.
+	//
+	// File layout: VgsHeader, VgsHeader::sectionCount VgsSectionEntry records, then the
+	// payload of each section starting at a VGS_SECTION_ALIGNMENT boundary.
+	constexpr char VGS_MAGIC[4] = { 'V', 'G', 'S', '\0' };
+	constexpr uint32_t VGS_VERSION = 3;
+	constexpr uint64_t VGS_SECTION_ALIGNMENT = 4096;
+
+	enum class VgsSectionType : uint32_t {
+		Positions = 1,
+		Covariances = 2,
+		SphericalHarmonics = 3,
+	};
+
+	struct VgsHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t gaussianCount;
+		// Size and modification time of the file the cache was built from
+		uint64_t sourceSize;
+		int64_t sourceTimestamp;
+		uint32_t sectionCount;
+		// The SphericalHarmonics section holds shCoefficientCount(shDegree) floats per splat
+		uint32_t shDegree;
+	};
+
+	struct VgsSectionEntry {
+		uint32_t type;
+		uint32_t stride;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// Streams splats into a .vgs file. Data goes to a temporary file that only replaces
+	// filepath in finish(), so an interrupted write never leaves a valid-looking cache.
+	class VgsWriter {
+	public:
+		VgsWriter(const std::string& filepath, const std::string& sourcePath, uint64_t gaussianCount, uint32_t shDegree);
+		~VgsWriter();
+
+		VgsWriter(const VgsWriter&) = delete;
+		VgsWriter& operator=(const VgsWriter&) = delete;
+
+		void append(const GaussianModel::SplatStreams& src, size_t count);
+		void finish();
+
+	private:
+		void writeSection(const VgsSectionEntry& section, const void* data, size_t count);
+
+		std::string filepath;
+		std::string tempFilepath;
+		std::string sourcePath;
+		std::ofstream file;
+
+		uint64_t gaussianCount;
+		uint32_t shDegree;
+		uint64_t writtenCount = 0;
+		std::vector<VgsSectionEntry> sections;
+		bool finished = false;
+	};
+
+	// Read-only view of a mapped .vgs file. Throws std::runtime_error if the file is not a
+	// valid cache for this build's Gaussian layout.
+	class VgsFile {
+	public:
+		explicit VgsFile(const std::string& filepath);
+
+		VgsFile(const VgsFile&) = delete;
+		VgsFile& operator=(const VgsFile&) = delete;
+
+		// True if the cache was built from the current contents of sourcePath
+		bool matchesSource(const std::string& sourcePath) const;
+
+		uint64_t getGaussianCount() const { return header.gaussianCount; }
+		uint32_t getShDegree() const { return header.shDegree; }
+		// Copies splats [first, first + count) into dst
+		void copyTo(size_t first, size_t count, const GaussianModel::SplatStreams& dst) const;
+
+	private:
+		const char* findSection(VgsSectionType type, uint32_t stride) const;
+
+		MappedFile mappedFile;
+		VgsHeader header{};
+		const GaussianModel::PositionOpacity* positions = nullptr;
+		const GaussianModel::Covariance* covariances = nullptr;
+		const float* sh = nullptr;
+	};
+}
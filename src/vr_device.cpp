@@ -1,8 +1,15 @@
 #include "vr_device.hpp"
 
+#include "transfer_manager.hpp"
+#include "pipelines/pipeline_compiler.hpp"
+
 // std headers
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
@@ -62,9 +69,23 @@ VrDevice::VrDevice(VrWindow &window) : window{window} {
   createCommandPool();
  // A command pool will help with compute command buffer allocation
   createComputeCommandPool();
+// Pipelines compiled on an earlier run come back from disk
+  createPipelineCache();
+// Hands out buffer memory from large blocks
+  memoryAllocator = std::make_unique<MemoryAllocator>(*this);
+// Batches buffer uploads, on the transfer queue when there is one
+  transferManager = std::make_unique<TransferManager>(*this);
+// Compiles pipelines concurrently
+  pipelineCompiler = std::make_unique<PipelineCompiler>();
 }
 
 VrDevice::~VrDevice() {
+  // Finishes any compiles still queued before the cache is saved
+  pipelineCompiler.reset();
+  transferManager.reset();
+  memoryAllocator.reset();
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyCommandPool(device_, computeCommandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
@@ -88,7 +109,8 @@ void VrDevice::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.2 for timeline semaphores
+  appInfo.apiVersion = VK_API_VERSION_1_2;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -145,33 +167,54 @@ void VrDevice::pickPhysicalDevice() {
 }
 
 void VrDevice::createLogicalDevice() {
-  QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  queueFamilies = findQueueFamilies(physicalDevice);
+  QueueFamilyIndices &indices = queueFamilies;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily, indices.presentFamily, indices.computeFamily, indices.transferFamily};
 
-  float queuePriority = 1.0f;
+  // Enough priorities for the graphics family's second queue when compute shares it
+  float queuePriorities[] = {1.0f, 1.0f};
   for (uint32_t queueFamily : uniqueQueueFamilies) {
     VkDeviceQueueCreateInfo queueCreateInfo = {};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queueCreateInfo.queueFamilyIndex = queueFamily;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    queueCreateInfo.queueCount = queueFamily == indices.computeFamily ? indices.computeQueueIndex + 1 : 1;
+    queueCreateInfo.pQueuePriorities = queuePriorities;
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = &vulkan12Features;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+  // Optional; reports whether each pipeline came from the cache
+  std::vector<const char *> enabledExtensions = deviceExtensions;
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0) {
+      enabledExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+      pipelineCreationFeedbackSupported = true;
+    }
+  }
+
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -188,7 +231,18 @@ void VrDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
-  vkGetDeviceQueue(device_, indices.computeFamily, 0, &computeQueue_);
+  vkGetDeviceQueue(device_, indices.computeFamily, indices.computeQueueIndex, &computeQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+
+  if (computeQueue_ == graphicsQueue_) {
+    std::cout << "compute shares the graphics queue" << std::endl;
+  }
+  if (transferQueue_ == graphicsQueue_) {
+    std::cout << "transfers share the graphics queue" << std::endl;
+  }
+
+  std::set<uint32_t> sharedFamilies = {indices.graphicsFamily, indices.computeFamily, indices.transferFamily};
+  sharedQueueFamilies.assign(sharedFamilies.begin(), sharedFamilies.end());
 }
 
 void VrDevice::createCommandPool() {
@@ -219,6 +273,181 @@ void VrDevice::createComputeCommandPool() {
     }
 }
 
+namespace {
+// Written ahead of the driver's blob. The driver validates its own header too, but rejecting a
+// blob from another device or driver version here avoids handing it stale data at all
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  uint64_t dataSize;
+};
+
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43505256;  // "VRPC"
+
+PipelineCacheFileHeader pipelineCacheFileHeader(const VkPhysicalDeviceProperties &properties) {
+  PipelineCacheFileHeader header{};
+  header.magic = PIPELINE_CACHE_MAGIC;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  header.driverVersion = properties.driverVersion;
+  std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  return header;
+}
+
+// The per-user cache directory, or an empty path when the environment names none
+std::filesystem::path userCacheDirectory() {
+#ifdef _WIN32
+  if (const char *localAppData = std::getenv("LOCALAPPDATA"); localAppData && *localAppData) {
+    return localAppData;
+  }
+#else
+  if (const char *xdgCache = std::getenv("XDG_CACHE_HOME"); xdgCache && *xdgCache) {
+    return xdgCache;
+  }
+  if (const char *home = std::getenv("HOME"); home && *home) {
+    return std::filesystem::path{home} / ".cache";
+  }
+#endif
+  return {};
+}
+}  // namespace
+
+void VrDevice::createPipelineCache() {
+  std::vector<char> cacheData;
+
+  // Falls back to the working directory only when there is no user cache directory to use
+  std::filesystem::path cacheDirectory = userCacheDirectory();
+  if (!cacheDirectory.empty()) {
+    cacheDirectory /= PIPELINE_CACHE_DIRECTORY;
+  }
+  pipelineCachePath = cacheDirectory / PIPELINE_CACHE_FILE;
+
+  std::ifstream file{pipelineCachePath, std::ios::binary};
+  if (file.is_open()) {
+    PipelineCacheFileHeader header{};
+    PipelineCacheFileHeader expected = pipelineCacheFileHeader(properties);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    if (!file || header.magic != expected.magic || header.vendorID != expected.vendorID ||
+        header.deviceID != expected.deviceID || header.driverVersion != expected.driverVersion ||
+        std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+      std::cout << "pipeline cache: ignoring " << pipelineCachePath.string()
+                << " from another device or driver" << std::endl;
+    } else {
+      // The size is only trusted once the file is known to hold that many bytes
+      const std::streamoff dataOffset = file.tellg();
+      file.seekg(0, std::ios::end);
+      const std::streamoff remaining = file.tellg() - dataOffset;
+      file.seekg(dataOffset);
+
+      if (!file || remaining < 0 || header.dataSize > static_cast<uint64_t>(remaining)) {
+        std::cout << "pipeline cache: " << pipelineCachePath.string() << " is truncated" << std::endl;
+      } else {
+        cacheData.resize(header.dataSize);
+        file.read(cacheData.data(), cacheData.size());
+        if (!file) {
+          std::cout << "pipeline cache: failed to read " << pipelineCachePath.string() << std::endl;
+          cacheData.clear();
+        }
+      }
+    }
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = cacheData.size();
+  cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    // The driver may still reject the blob; start empty rather than fail
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    cacheData.clear();
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create pipeline cache!");
+    }
+  }
+
+  loadedPipelineCacheSize = cacheData.size();
+  std::cout << "pipeline cache: loaded " << loadedPipelineCacheSize << " bytes" << std::endl;
+}
+
+void VrDevice::savePipelineCache() {
+  {
+    std::lock_guard<std::mutex> lock{pipelineStatsMutex};
+    std::cout << "pipeline cache: " << pipelineStats.hits << " hits in " << pipelineStats.hitSeconds * 1000.f
+              << " ms, " << pipelineStats.misses << " misses in " << pipelineStats.missSeconds * 1000.f
+              << " ms";
+    if (pipelineStats.unknown > 0) {
+      std::cout << ", " << pipelineStats.unknown << " unreported in " << pipelineStats.unknownSeconds * 1000.f
+                << " ms";
+    }
+    std::cout << std::endl;
+  }
+
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+    return;
+  }
+  std::vector<char> cacheData(dataSize);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, cacheData.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  PipelineCacheFileHeader header = pipelineCacheFileHeader(properties);
+  header.dataSize = dataSize;
+
+  std::error_code error;
+  if (pipelineCachePath.has_parent_path()) {
+    std::filesystem::create_directories(pipelineCachePath.parent_path(), error);
+    if (error) {
+      std::cerr << "pipeline cache: failed to create " << pipelineCachePath.parent_path().string() << ": "
+                << error.message() << std::endl;
+      return;
+    }
+  }
+
+  // Written next to the old file and renamed over it, so a crash never leaves a torn cache
+  std::filesystem::path tempPath = pipelineCachePath;
+  tempPath += ".tmp";
+  {
+    std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+      std::cerr << "pipeline cache: failed to write " << tempPath.string() << std::endl;
+      return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(cacheData.data(), dataSize);
+    if (!file) {
+      std::cerr << "pipeline cache: failed to write " << tempPath.string() << std::endl;
+      return;
+    }
+  }
+
+  std::filesystem::rename(tempPath, pipelineCachePath, error);
+  if (error) {
+    std::cerr << "pipeline cache: failed to replace " << pipelineCachePath.string() << ": " << error.message()
+              << std::endl;
+  }
+}
+
+void VrDevice::recordPipelineCreation(const VkPipelineCreationFeedbackEXT *feedback, float seconds) {
+  std::lock_guard<std::mutex> lock{pipelineStatsMutex};
+  if (!feedback || !(feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+    pipelineStats.unknown++;
+    pipelineStats.unknownSeconds += seconds;
+  } else if (feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) {
+    pipelineStats.hits++;
+    pipelineStats.hitSeconds += seconds;
+  } else {
+    pipelineStats.misses++;
+    pipelineStats.missSeconds += seconds;
+  }
+}
+
 void VrDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
 
 bool VrDevice::isDeviceSuitable(VkPhysicalDevice device) {
@@ -235,8 +464,22 @@ bool VrDevice::isDeviceSuitable(VkPhysicalDevice device) {
   VkPhysicalDeviceFeatures supportedFeatures;
   vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+  bool timelineSemaphoreSupported = false;
+  if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    timelineSemaphoreSupported = vulkan12Features.timelineSemaphore;
+  }
+
   return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-         supportedFeatures.samplerAnisotropy;
+         supportedFeatures.samplerAnisotropy && timelineSemaphoreSupported;
 }
 
 void VrDevice::populateDebugMessengerCreateInfo(
@@ -352,27 +595,45 @@ QueueFamilyIndices VrDevice::findQueueFamilies(VkPhysicalDevice device) {
   std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-  int i = 0;
-  for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    const VkQueueFamilyProperties &queueFamily = queueFamilies[i];
+    if (queueFamily.queueCount == 0) {
+      continue;
+    }
+
+    if (!indices.graphicsFamilyHasValue && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
-        indices.computeFamily = i;
-        indices.computeFamilyHasValue = true;
-    }
     VkBool32 presentSupport = false;
     vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
+    if (!indices.presentFamilyHasValue && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
     }
-    if (indices.isComplete()) {
-      break;
+    // A compute-only family is the async compute queue on most discrete GPUs
+    if (!indices.computeFamilyHasValue && queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT &&
+        !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+      indices.computeFamily = i;
+      indices.computeFamilyHasValue = true;
+    }
+    if (!indices.transferFamilyHasValue && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+        !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      indices.transferFamily = i;
+      indices.transferFamilyHasValue = true;
     }
+  }
 
-    i++;
+  // Otherwise a second queue of the graphics family, or the graphics queue itself. Graphics
+  // families always support compute
+  if (!indices.computeFamilyHasValue && indices.graphicsFamilyHasValue) {
+    indices.computeFamily = indices.graphicsFamily;
+    indices.computeQueueIndex = queueFamilies[indices.graphicsFamily].queueCount > 1 ? 1 : 0;
+    indices.computeFamilyHasValue = true;
+  }
+  if (!indices.transferFamilyHasValue && indices.graphicsFamilyHasValue) {
+    indices.transferFamily = indices.graphicsFamily;
+    indices.transferFamilyHasValue = true;
   }
 
   return indices;
@@ -438,12 +699,21 @@ void VrDevice::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    MemoryAllocation &bufferMemory,
+    AllocationStrategy strategy) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // Buffers written on one queue and read on another would otherwise need ownership transfers
+  if (sharedQueueFamilies.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+  } else {
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
 
   if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to create buffer!");
@@ -452,16 +722,38 @@ void VrDevice::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferMemory = memoryAllocator->allocate(memRequirements, properties, strategy);
+
+  vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset);
+}
+
+VkSemaphore VrDevice::createTimelineSemaphore(uint64_t initialValue) {
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = initialValue;
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  VkSemaphore semaphore;
+  if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
   }
+  return semaphore;
+}
+
+void VrDevice::waitForTimeline(VkSemaphore semaphore, uint64_t value) {
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore;
+  waitInfo.pValues = &value;
 
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+  if (vkWaitSemaphores(device_, &waitInfo, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to wait for timeline semaphore!");
+  }
 }
 
 VkCommandBuffer VrDevice::beginSingleTimeCommands() {
@@ -496,18 +788,6 @@ void VrDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void VrDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0;  // Optional
-  copyRegion.dstOffset = 0;  // Optional
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  endSingleTimeCommands(commandBuffer);
-}
-
 void VrDevice::copyBufferToImage(
     VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -1,14 +1,21 @@
 #pragma once
 
 #include "vr_window.hpp"
+#include "memory_allocator.hpp"
 
 // std lib headers
+#include <filesystem>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <vulkan/vulkan.h>
 
 namespace vr {
 
+class TransferManager;
+class PipelineCompiler;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -19,10 +26,18 @@ struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
   uint32_t computeFamily;
+  // Index of the compute queue within computeFamily. Compute gets its own queue whenever the
+  // device has one to spare, so it can overlap graphics work
+  uint32_t computeQueueIndex = 0;
+  // A transfer-only family when the device has one (its copy engine), otherwise the graphics family
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
   bool computeFamilyHasValue = false;
-  bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue && computeFamilyHasValue; }
+  bool transferFamilyHasValue = false;
+  bool isComplete() {
+    return graphicsFamilyHasValue && presentFamilyHasValue && computeFamilyHasValue && transferFamilyHasValue;
+  }
 };
 
 class VrDevice {
@@ -49,7 +64,18 @@ class VrDevice {
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
   VkQueue computeQueue() { return computeQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
+  uint32_t transferFamily() { return queueFamilies.transferFamily; }
+  // Batches buffer uploads for the device. See transfer_manager.hpp
+  TransferManager &transfers() { return *transferManager; }
+  // Sub-allocates buffer memory. See memory_allocator.hpp
+  MemoryAllocator &allocator() { return *memoryAllocator; }
   VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
+  // Compiles pipelines on worker threads. See pipelines/pipeline_compiler.hpp
+  PipelineCompiler &pipelines() { return *pipelineCompiler; }
+  // Shared by every pipeline. Loaded from the per-user cache directory at startup and saved back on
+  // destruction
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
   VkInstance getInstance() { return instance; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
@@ -64,13 +90,29 @@ class VrDevice {
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      MemoryAllocation &bufferMemory,
+      AllocationStrategy strategy = AllocationStrategy::FreeList);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
+  // Timeline semaphores (Vulkan 1.2) order the frame's compute and graphics submissions and
+  // let the host wait for a given submission without a fence per frame
+  VkSemaphore createTimelineSemaphore(uint64_t initialValue = 0);
+  // Blocks until semaphore reaches value
+  void waitForTimeline(VkSemaphore semaphore, uint64_t value);
+
+  // The distinct graphics, compute and transfer families. With more than one, resources used
+  // across queues are created with VK_SHARING_MODE_CONCURRENT over these
+  const std::vector<uint32_t> &getSharedQueueFamilies() { return sharedQueueFamilies; }
+
+  // Pipelines chain this into their create info through VkPipelineCreationFeedbackCreateInfoEXT
+  // when it is set, so the cache hits can be told apart from compiles
+  bool hasPipelineCreationFeedback() { return pipelineCreationFeedbackSupported; }
+  // Adds one pipeline's creation to the cache report printed at shutdown. feedback may be null
+  void recordPipelineCreation(const VkPipelineCreationFeedbackEXT *feedback, float seconds);
+
   void createImageWithInfo(
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
@@ -87,6 +129,8 @@ class VrDevice {
   void createLogicalDevice();
   void createCommandPool();
   void createComputeCommandPool();
+  void createPipelineCache();
+  void savePipelineCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -110,9 +154,38 @@ class VrDevice {
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
   VkQueue computeQueue_;
+  VkQueue transferQueue_;
+  QueueFamilyIndices queueFamilies;
+  std::vector<uint32_t> sharedQueueFamilies;
+
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  // Resolved once by createPipelineCache, so the save goes where the load came from
+  std::filesystem::path pipelineCachePath;
+  size_t loadedPipelineCacheSize = 0;
+  bool pipelineCreationFeedbackSupported = false;
+
+  // Pipeline creation report, updated from any thread
+  struct PipelineCreationStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t unknown = 0;
+    float hitSeconds = 0.f;
+    float missSeconds = 0.f;
+    float unknownSeconds = 0.f;
+  };
+  std::mutex pipelineStatsMutex;
+  PipelineCreationStats pipelineStats;
+
+  std::unique_ptr<MemoryAllocator> memoryAllocator;
+  std::unique_ptr<TransferManager> transferManager;
+  std::unique_ptr<PipelineCompiler> pipelineCompiler;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+  // Created under XDG_CACHE_HOME (or ~/.cache) or LOCALAPPDATA, not the working directory
+  static constexpr const char *PIPELINE_CACHE_DIRECTORY = "VulkanRenderer";
+  static constexpr const char *PIPELINE_CACHE_FILE = "pipeline_cache.bin";
 };
 
 }  // namespace vr
\ No newline at end of file
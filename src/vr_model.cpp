@@ -1,5 +1,6 @@
 #include "vr_model.hpp"
 
+#include "transfer_manager.hpp"
 #include "utils.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -60,16 +61,6 @@ namespace vr {
 		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
 		
 		uint32_t vertexSize = sizeof(vertices[0]);
-		Buffer stagingBuffer{
-			vrDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		};
-
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
 
 		vertexBuffer = std::make_unique<Buffer>(
 			vrDevice,
@@ -79,7 +70,7 @@ namespace vr {
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 		);
 
-		vrDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+		vrDevice.transfers().upload(vertices.data(), bufferSize, vertexBuffer->getBuffer());
 	}
 
 	void VrModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
@@ -93,17 +84,6 @@ namespace vr {
 		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
 		uint32_t indexSize = sizeof(indices[0]);
 
-		Buffer stagingBuffer{
-			vrDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
-
 		indexBuffer = std::make_unique<Buffer>(
 			vrDevice,
 			indexSize,
@@ -112,7 +92,7 @@ namespace vr {
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 		);
 
-		vrDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		vrDevice.transfers().upload(indices.data(), bufferSize, indexBuffer->getBuffer());
 	}
 
 	void VrModel::draw(VkCommandBuffer commandBuffer) {
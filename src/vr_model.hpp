@@ -35,6 +35,7 @@ namespace vr {
 			void loadModel(const std::string& filepath);
 		};
 
+		// Uploads go through the device's TransferManager; flush it before the model is first drawn
 		VrModel(VrDevice & device, const VrModel::Builder &builder);
 		~VrModel();
 
@@ -61,19 +61,17 @@ VrSwapChain::~VrSwapChain() {
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroySemaphore(device.device(), computeFinishedSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), computeInFlightFences[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
   }
+  vkDestroySemaphore(device.device(), computeTimeline, nullptr);
+  vkDestroySemaphore(device.device(), graphicsTimeline, nullptr);
 }
 
 VkResult VrSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(
-      device.device(),
-      1,
-      &inFlightFences[currentFrame],
-      VK_TRUE,
-      std::numeric_limits<uint64_t>::max());
+  // The frame that last used this slot's resources must be done. Its graphics submission waited
+  // on its compute submission, so one timeline covers both
+  if (frameNumber >= MAX_FRAMES_IN_FLIGHT) {
+    device.waitForTimeline(graphicsTimeline, frameNumber + 1 - MAX_FRAMES_IN_FLIGHT);
+  }
 
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
@@ -89,31 +87,53 @@ VkResult VrSwapChain::acquireNextImage(uint32_t *imageIndex) {
 VkResult VrSwapChain::submitCommandBuffers(
     const VkCommandBuffer *buffers, const VkCommandBuffer *computeCommandBuffer, uint32_t *imageIndex) {
 
-  vkWaitForFences(device.device(), 1, &computeInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+  // Value both timelines reach once this frame's submission finishes
+  uint64_t frameValue = frameNumber + 1;
 
-  vkResetFences(device.device(), 1, &computeInFlightFences[currentFrame]);
+  // Compute never waits on the host: the slot's previous frame was waited for in acquireNextImage
+  VkTimelineSemaphoreSubmitInfo computeTimelineInfo = {};
+  computeTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  computeTimelineInfo.signalSemaphoreValueCount = 1;
+  computeTimelineInfo.pSignalSemaphoreValues = &frameValue;
 
   VkSubmitInfo computeSubmitInfo = {};
   computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  computeSubmitInfo.pNext = &computeTimelineInfo;
   computeSubmitInfo.commandBufferCount = 1;
   computeSubmitInfo.pCommandBuffers = computeCommandBuffer;
   computeSubmitInfo.signalSemaphoreCount = 1;
-  computeSubmitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+  computeSubmitInfo.pSignalSemaphores = &computeTimeline;
 
-  if (vkQueueSubmit(device.computeQueue(), 1, &computeSubmitInfo, computeInFlightFences[currentFrame]) != VK_SUCCESS) {
+  if (vkQueueSubmit(device.computeQueue(), 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
      throw std::runtime_error("Failed to submit compute command buffer");
   }
 
-  if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-    vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+  if (imagesInFlight[*imageIndex] != 0) {
+    device.waitForTimeline(graphicsTimeline, imagesInFlight[*imageIndex]);
   }
-  imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+  imagesInFlight[*imageIndex] = frameValue;
+
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame], computeTimeline};
+  // The binary semaphore's value is ignored
+  uint64_t waitValues[] = {0, frameValue};
+  // Compute output is first read by indirect draw parameters, then by the shaders after them, so
+  // the graphics queue runs everything before the indirect draws while compute is still going
+  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT};
+
+  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], graphicsTimeline};
+  uint64_t signalValues[] = {0, frameValue};
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = 2;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
+  timelineInfo.signalSemaphoreValueCount = 2;
+  timelineInfo.pSignalSemaphoreValues = signalValues;
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame], computeFinishedSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT};
   submitInfo.waitSemaphoreCount = 2;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
@@ -121,13 +141,10 @@ VkResult VrSwapChain::submitCommandBuffers(
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = buffers;
 
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.signalSemaphoreCount = 2;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-      VK_SUCCESS) {
+  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
   }
 
@@ -135,7 +152,7 @@ VkResult VrSwapChain::submitCommandBuffers(
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
   presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
+  presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
   VkSwapchainKHR swapChains[] = {swapChain};
   presentInfo.swapchainCount = 1;
@@ -146,6 +163,7 @@ VkResult VrSwapChain::submitCommandBuffers(
   auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
   currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  frameNumber++;
 
   return result;
 }
@@ -370,32 +388,22 @@ void VrSwapChain::createDepthResources() {
 void VrSwapChain::createSyncObjects() {
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+  imagesInFlight.resize(imageCount(), 0);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo = {};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
             VK_SUCCESS ||
         vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-            VK_SUCCESS ||
-        vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &computeFinishedSemaphores[i]) != 
-            VK_SUCCESS ||
-        vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != 
-            VK_SUCCESS ||
-        vkCreateFence(device.device(), &fenceInfo, nullptr, &computeInFlightFences[i]) !=
             VK_SUCCESS) {
       throw std::runtime_error("failed to create synchronization objects for a frame!");
     }
   }
+
+  computeTimeline = device.createTimelineSemaphore();
+  graphicsTimeline = device.createTimelineSemaphore();
 }
 
 VkSurfaceFormatKHR VrSwapChain::chooseSwapSurfaceFormat(
@@ -82,11 +82,14 @@ class VrSwapChain {
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkSemaphore> computeFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
-  std::vector<VkFence> computeInFlightFences;
-  std::vector<VkFence> imagesInFlight;
+  // Frame n's compute and graphics submissions signal these to n + 1. Graphics waits on compute on
+  // the GPU, and the host only waits on graphics for the frame whose slot it reuses
+  VkSemaphore computeTimeline;
+  VkSemaphore graphicsTimeline;
+  // graphicsTimeline value of the last frame that rendered to each image, 0 if none
+  std::vector<uint64_t> imagesInFlight;
   size_t currentFrame = 0;
+  uint64_t frameNumber = 0;
 };
 
 }  // namespace vr
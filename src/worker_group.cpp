@@ -0,0 +1,92 @@
+#include "worker_group.hpp"
+
+namespace vr {
+
+	WorkerGroup::WorkerGroup(uint32_t threadCount) {
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers.emplace_back([this] { workerLoop(); });
+		}
+	}
+
+	WorkerGroup::~WorkerGroup() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		startCondition.notify_all();
+
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void WorkerGroup::runJob(size_t count, Invoke invoke, void* context) {
+		if (count == 0) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			jobInvoke = invoke;
+			jobContext = context;
+			jobCount = count;
+			nextIndex.store(0, std::memory_order_relaxed);
+			activeWorkers = workers.size();
+			generation++;
+		}
+		startCondition.notify_all();
+
+		runIndices();
+
+		std::exception_ptr jobError;
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+			jobError = std::move(error);
+			error = nullptr;
+		}
+		if (jobError) {
+			std::rethrow_exception(jobError);
+		}
+	}
+
+	void WorkerGroup::runIndices() {
+		for (;;) {
+			size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+			if (index >= jobCount) {
+				return;
+			}
+
+			try {
+				jobInvoke(jobContext, index);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock{ mutex };
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	}
+
+	void WorkerGroup::workerLoop() {
+		uint64_t lastGeneration = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				startCondition.wait(lock, [&] { return stopping || generation != lastGeneration; });
+				if (stopping) {
+					return;
+				}
+				lastGeneration = generation;
+			}
+
+			runIndices();
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (--activeWorkers == 0) {
+				doneCondition.notify_one();
+			}
+		}
+	}
+}
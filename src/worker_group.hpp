@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace vr {
+
+	// Fixed threads that run one parallel job at a time, for per-frame work. Unlike ThreadPool,
+	// whose task queues hold std::functions, running a job makes no heap allocations.
+	// Used from one thread at a time.
+	class WorkerGroup {
+	public:
+		explicit WorkerGroup(uint32_t threadCount);
+		~WorkerGroup();
+
+		WorkerGroup(const WorkerGroup&) = delete;
+		WorkerGroup& operator=(const WorkerGroup&) = delete;
+
+		// Calls fn(i) for every i in [0, count), on the workers and the calling thread, and returns
+		// once all calls have finished. The first exception thrown by fn is rethrown then.
+		template <typename Fn>
+		void run(size_t count, Fn&& fn) {
+			using Function = std::remove_reference_t<Fn>;
+			runJob(count, [](void* context, size_t index) { (*static_cast<Function*>(context))(index); }, &fn);
+		}
+
+	private:
+		using Invoke = void (*)(void* context, size_t index);
+
+		void runJob(size_t count, Invoke invoke, void* context);
+		// Claims and runs indices of the current job until there are none left
+		void runIndices();
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable startCondition;
+		std::condition_variable doneCondition;
+		// Bumped for every job, so a worker can tell a new one from the one it last ran
+		uint64_t generation = 0;
+		bool stopping = false;
+
+		Invoke jobInvoke = nullptr;
+		void* jobContext = nullptr;
+		size_t jobCount = 0;
+		std::atomic<size_t> nextIndex{ 0 };
+		// Workers that have not finished the current job; run() waits for all of them, since
+		// they may still read the job after its last index has been claimed
+		size_t activeWorkers = 0;
+		std::exception_ptr error;
+	};
+}
@@ -0,0 +1,90 @@
+#include "allocation_counter.hpp"
+
+#include "ImGui/imgui.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	std::atomic<uint64_t> allocationCount{ 0 };
+
+	void* allocate(std::size_t size) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		if (void* memory = std::malloc(std::max<std::size_t>(size, 1))) {
+			return memory;
+		}
+		throw std::bad_alloc{};
+	}
+
+	void* allocateAligned(std::size_t size, std::size_t alignment) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		size = std::max<std::size_t>(size, 1);
+#ifdef _WIN32
+		void* memory = _aligned_malloc(size, alignment);
+#else
+		void* memory = nullptr;
+		if (posix_memalign(&memory, std::max(alignment, sizeof(void*)), size) != 0) {
+			memory = nullptr;
+		}
+#endif
+		if (memory) {
+			return memory;
+		}
+		throw std::bad_alloc{};
+	}
+
+	void freeAligned(void* memory) {
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+
+	void* allocateImGui(std::size_t size, void*) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size);
+	}
+
+	void freeImGui(void* memory, void*) {
+		std::free(memory);
+	}
+}
+
+// The standard library's array and nothrow forms forward to these
+void* operator new(std::size_t size) {
+	return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return allocateAligned(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+namespace vr {
+
+	uint64_t getAllocationCount() {
+		return allocationCount.load(std::memory_order_relaxed);
+	}
+
+	void countImGuiAllocations() {
+		ImGui::SetAllocatorFunctions(allocateImGui, freeImGui);
+	}
+}
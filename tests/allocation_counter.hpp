@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vr {
+
+	// Linking allocation_counter.cpp replaces the global operator new with one that counts. Only
+	// the allocation test links it
+
+	// Heap allocations since startup, from any thread: every operator new, plus ImGui's
+	// allocations once countImGuiAllocations has been called. C libraries and the Vulkan driver
+	// calling malloc directly are not seen
+	uint64_t getAllocationCount();
+
+	// ImGui allocates through malloc unless given allocator functions; these count. Call before
+	// the ImGui context is created, so nothing it allocated earlier is freed through them
+	void countImGuiAllocations();
+}
@@ -0,0 +1,216 @@
+// Renders a small scene through the same per-frame path as FirstApp and fails if a frame makes a
+// heap allocation once the scene has settled. The scene is the cube, the ImGui demo window and,
+// when a PLY path is given as the first argument, a streamed Gaussian model. Needs a Vulkan
+// device and a display for the (hidden) window.
+
+#include "allocation_counter.hpp"
+
+#include "vr_window.hpp"
+#include "vr_device.hpp"
+#include "renderer.hpp"
+#include "imgui_manager.hpp"
+#include "buffer.hpp"
+#include "descriptors.hpp"
+#include "frame_info.hpp"
+#include "camera.hpp"
+#include "transfer_manager.hpp"
+#include "systems/simple_render/simple_render.hpp"
+#include "systems/gaussian_render/gaussian_render.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	// Frames after loading or a resize before frames must stop allocating. Covers caches and
+	// pools that grow on first use
+	constexpr uint32_t WARMUP_FRAMES = 60;
+	constexpr uint32_t MEASURED_FRAMES = 240;
+	// Gives up on a scene that never settles, e.g. one still streaming
+	constexpr uint32_t MAX_FRAMES = 20000;
+}
+
+int main(int argc, char** argv) {
+	using namespace vr;
+
+	// ImGui's allocations only reach the count through its allocator functions
+	countImGuiAllocations();
+
+	// Frames are presented, but nobody needs to see them
+	glfwInit();
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	try {
+		VrWindow window{ 800, 600, "Frame allocation test" };
+		VrDevice device{ window };
+		Renderer renderer{ window, device };
+
+		auto globalPool = VrDescriptorPool::Builder(device)
+			.setMaxSets(VrSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VrSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+		auto globalSetLayout = VrDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		std::vector<std::unique_ptr<Buffer>> uboBuffers(VrSwapChain::MAX_FRAMES_IN_FLIGHT);
+		std::vector<VkDescriptorSet> globalDescriptorSets(VrSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (int i = 0; i < VrSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+			uboBuffers[i] = std::make_unique<Buffer>(
+				device,
+				sizeof(GlobalUbo),
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			uboBuffers[i]->map();
+
+			auto bufferInfo = uboBuffers[i]->descriptorInfo();
+			VrDescriptorWriter(*globalSetLayout, *globalPool)
+				.writeBuffer(0, &bufferInfo)
+				.build(globalDescriptorSets[i]);
+		}
+
+		SimpleRenderSystem simpleRenderSystem{
+			device,
+			renderer.getSwapChainRenderPass(),
+			globalSetLayout->getDescriptorSetLayout()
+		};
+
+		std::vector<VrGameObject> gameObjects;
+		auto cube = VrGameObject::createGameObject();
+		cube.model = VrModel::createModelFromCube(device);
+		gameObjects.push_back(std::move(cube));
+
+		std::unique_ptr<GaussianRenderSystem> gaussianRenderSystem;
+		std::vector<VrGameObject> gaussianObjects;
+		if (argc > 1) {
+			GaussianLoadOptions options{};
+			options.streaming = true;
+			gaussianRenderSystem = std::make_unique<GaussianRenderSystem>(
+				argv[1],
+				device,
+				renderer.getSwapChainRenderPass(),
+				globalSetLayout->getDescriptorSetLayout(),
+				options);
+
+			auto gaussian = VrGameObject::createGameObject();
+			gaussian.gaussianModel = gaussianRenderSystem->createModel();
+			gaussianObjects.push_back(std::move(gaussian));
+		}
+		device.transfers().flush();
+
+		ImGuiManager imGuiManager{ window, device, renderer };
+
+		Camera camera{};
+		camera.setViewYXZ({ 0.f, 0.f, -3.f }, { 0.f, 0.f, 0.f });
+
+		int bindIdx = 0;
+		int gaussianBindIdx = 1;
+
+		const FrameInfo* recordingFrameInfo = nullptr;
+		std::vector<Renderer::SecondaryRecorder> passRecorders{
+			[&](VkCommandBuffer secondaryCommandBuffer) {
+				FrameInfo systemFrameInfo = *recordingFrameInfo;
+				systemFrameInfo.commandBuffer = secondaryCommandBuffer;
+				simpleRenderSystem.renderGameObjects(systemFrameInfo, gameObjects, bindIdx);
+			},
+			[&](VkCommandBuffer secondaryCommandBuffer) {
+				imGuiManager.renderImGui(secondaryCommandBuffer);
+			}
+		};
+		if (gaussianRenderSystem) {
+			passRecorders.insert(passRecorders.begin() + 1, [&](VkCommandBuffer secondaryCommandBuffer) {
+				FrameInfo systemFrameInfo = *recordingFrameInfo;
+				systemFrameInfo.commandBuffer = secondaryCommandBuffer;
+				gaussianRenderSystem->renderGameObjects(systemFrameInfo, gaussianObjects, gaussianBindIdx);
+			});
+		}
+
+		uint32_t settledFrames = 0;
+		uint32_t measuredFrames = 0;
+		uint32_t allocatingFrames = 0;
+		VkExtent2D settledExtent = renderer.getSwapChainExtent();
+
+		for (uint32_t frameNumber = 0; frameNumber < MAX_FRAMES && measuredFrames < MEASURED_FRAMES; frameNumber++) {
+			const uint64_t allocationsBefore = getAllocationCount();
+
+			glfwPollEvents();
+			camera.setPerspectiveProjection(glm::radians(50.f), renderer.getAspectRatio(), 0.1f, 10.f);
+
+			FrameHandles frame = renderer.beginFrame();
+			if (frame) {
+				VkExtent2D extent = renderer.getSwapChainExtent();
+				FrameInfo frameInfo{
+					frame.frameIndex,
+					1.f / 60.f,
+					frame.commandBuffer,
+					frame.computeCommandBuffer,
+					camera,
+					globalDescriptorSets[frame.frameIndex],
+					extent
+				};
+
+				GlobalUbo ubo{};
+				ubo.projectionView = camera.getProjection() * camera.getView();
+				ubo.view = camera.getView();
+				ubo.projection = camera.getProjection();
+				ubo.cameraPosition = glm::vec4{ camera.getPosition(), 1.f };
+				ubo.viewport = { static_cast<float>(extent.width), static_cast<float>(extent.height) };
+				uboBuffers[frame.frameIndex]->writeToBuffer(&ubo);
+				uboBuffers[frame.frameIndex]->flush();
+
+				if (gaussianRenderSystem) {
+					gaussianRenderSystem->resize(extent);
+					gaussianRenderSystem->uploadStreamedGaussians(frameInfo);
+				}
+
+				imGuiManager.newFrame();
+
+				recordingFrameInfo = &frameInfo;
+				renderer.beginSwapChainRenderPass(frame.commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				renderer.recordSecondaryCommandBuffers(frame.commandBuffer, passRecorders);
+				renderer.endSwapChainRenderPass(frame.commandBuffer);
+				recordingFrameInfo = nullptr;
+				renderer.endFrame();
+			}
+
+			const uint64_t frameAllocations = getAllocationCount() - allocationsBefore;
+
+			// Loading, a skipped frame or a new extent starts the warm-up again
+			const VkExtent2D extent = renderer.getSwapChainExtent();
+			if (!frame || (gaussianRenderSystem && gaussianRenderSystem->isStreaming()) ||
+				extent.width != settledExtent.width || extent.height != settledExtent.height) {
+				settledFrames = 0;
+				settledExtent = extent;
+				continue;
+			}
+			if (++settledFrames <= WARMUP_FRAMES) {
+				continue;
+			}
+
+			measuredFrames++;
+			if (frameAllocations != 0) {
+				allocatingFrames++;
+				std::cerr << "frame " << frameNumber << " made " << frameAllocations << " heap allocations\n";
+			}
+		}
+
+		vkDeviceWaitIdle(device.device());
+
+		if (measuredFrames < MEASURED_FRAMES) {
+			std::cerr << "the scene did not settle within " << MAX_FRAMES << " frames\n";
+			return EXIT_FAILURE;
+		}
+		std::cout << allocatingFrames << " of " << measuredFrames << " steady-state frames allocated\n";
+		return allocatingFrames == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,377 @@
+// Runs each compute primitive in src/pipelines on known input and compares the result with a
+// CPU reference, then reports how long the GPU took at a larger size. Needs a Vulkan device and
+// a display for the (hidden) window the device is created against.
+
+#include "vr_window.hpp"
+#include "vr_device.hpp"
+#include "buffer.hpp"
+#include "pipelines/gpu_primitives.hpp"
+#include "pipelines/gpu_radix_sort.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	using namespace vr;
+
+	// Not a multiple of any workgroup or block size, so partial blocks are covered
+	constexpr uint32_t CHECK_COUNT = 100'003;
+	// Timed, and checked as well
+	constexpr uint32_t BENCHMARK_COUNT = 1u << 22;
+
+	// Records commands into a one-time command buffer, waits for them and reads the GPU time
+	// between startTimer and stopTimer
+	class ComputeRunner {
+	public:
+		ComputeRunner(VrDevice& device) : vrDevice{ device } {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+
+			if (vkCreateQueryPool(vrDevice.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create timestamp query pool");
+			}
+		}
+
+		~ComputeRunner() {
+			vkDestroyQueryPool(vrDevice.device(), queryPool, nullptr);
+		}
+
+		ComputeRunner(const ComputeRunner&) = delete;
+		ComputeRunner& operator=(const ComputeRunner&) = delete;
+
+		// Returns the milliseconds between the timer calls record makes
+		template <typename Record>
+		double run(Record&& record) {
+			VkCommandBuffer commandBuffer = vrDevice.beginSingleTimeCommands();
+			vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+
+			record(commandBuffer);
+
+			// Results are read through host-visible buffers
+			memoryBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_HOST_BIT,
+				VK_ACCESS_HOST_READ_BIT);
+			vrDevice.endSingleTimeCommands(commandBuffer);
+
+			uint64_t timestamps[2];
+			if (vkGetQueryPoolResults(
+				vrDevice.device(), queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to read timestamps");
+			}
+			return static_cast<double>(timestamps[1] - timestamps[0]) * vrDevice.properties.limits.timestampPeriod / 1e6;
+		}
+
+		void startTimer(VkCommandBuffer commandBuffer) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+		}
+
+		void stopTimer(VkCommandBuffer commandBuffer) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+		}
+
+	private:
+		VrDevice& vrDevice;
+		VkQueryPool queryPool;
+	};
+
+	struct CheckResult {
+		bool passed;
+		double milliseconds;
+	};
+
+	std::unique_ptr<Buffer> createHostBuffer(VrDevice& device, uint32_t count) {
+		auto buffer = std::make_unique<Buffer>(
+			device,
+			sizeof(uint32_t),
+			std::max(count, 1u),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		buffer->map();
+		return buffer;
+	}
+
+	std::unique_ptr<Buffer> createHostBuffer(VrDevice& device, const std::vector<uint32_t>& values) {
+		auto buffer = createHostBuffer(device, static_cast<uint32_t>(values.size()));
+		std::memcpy(buffer->getMappedMemory(), values.data(), values.size() * sizeof(uint32_t));
+		return buffer;
+	}
+
+	std::vector<uint32_t> readBuffer(const Buffer& buffer, size_t count) {
+		const uint32_t* mapped = static_cast<const uint32_t*>(buffer.getMappedMemory());
+		return std::vector<uint32_t>(mapped, mapped + count);
+	}
+
+	std::vector<uint32_t> randomValues(std::mt19937& random, size_t count, uint32_t maxValue) {
+		std::uniform_int_distribution<uint32_t> distribution{ 0, maxValue };
+		std::vector<uint32_t> values(count);
+		for (auto& value : values) {
+			value = distribution(random);
+		}
+		return values;
+	}
+
+	bool expectEqual(const std::string& name, const std::vector<uint32_t>& actual, const std::vector<uint32_t>& expected) {
+		auto mismatch = std::mismatch(actual.begin(), actual.end(), expected.begin(), expected.end());
+		if (mismatch.first == actual.end() && mismatch.second == expected.end()) {
+			return true;
+		}
+		if (actual.size() != expected.size()) {
+			std::cerr << name << ": " << actual.size() << " values, expected " << expected.size() << "\n";
+		}
+		else {
+			size_t index = mismatch.first - actual.begin();
+			std::cerr << name << ": value " << index << " is " << *mismatch.first << ", expected " << *mismatch.second << "\n";
+		}
+		return false;
+	}
+
+	CheckResult checkScan(VrDevice& device, ComputeRunner& runner, std::mt19937& random, uint32_t count) {
+		std::vector<uint32_t> values = randomValues(random, count, 15);
+		std::vector<uint32_t> expected(count + 1, 0);
+		std::exclusive_scan(values.begin(), values.end(), expected.begin(), 0u);
+		expected[count] = count > 0 ? expected[count - 1] + values[count - 1] : 0;
+
+		auto input = createHostBuffer(device, values);
+		auto output = createHostBuffer(device, count + 1);
+
+		GpuScan scan{ device, 1 };
+		auto bindings = scan.createBindings(input->descriptorInfo(), output->descriptorInfo(), count);
+		double milliseconds = runner.run([&](VkCommandBuffer commandBuffer) {
+			runner.startTimer(commandBuffer);
+			scan.scan(commandBuffer, *bindings, count);
+			runner.stopTimer(commandBuffer);
+		});
+
+		return { expectEqual("scan", readBuffer(*output, count + 1), expected), milliseconds };
+	}
+
+	CheckResult checkCompact(VrDevice& device, ComputeRunner& runner, std::mt19937& random, uint32_t count) {
+		std::vector<uint32_t> values(count);
+		std::iota(values.begin(), values.end(), 1u);
+		// Half the flags are 0 and the rest 2 or 3, which keep their value just as 1 would
+		std::vector<uint32_t> flags = randomValues(random, count, 3);
+		for (auto& flag : flags) {
+			flag = flag < 2 ? 0 : flag;
+		}
+
+		std::vector<uint32_t> expected;
+		for (uint32_t i = 0; i < count; i++) {
+			if (flags[i] != 0) {
+				expected.push_back(values[i]);
+			}
+		}
+
+		auto valuesBuffer = createHostBuffer(device, values);
+		auto flagsBuffer = createHostBuffer(device, flags);
+		auto output = createHostBuffer(device, count);
+		auto keptCount = createHostBuffer(device, 1);
+
+		GpuCompact compact{ device, 1 };
+		auto bindings = compact.createBindings(
+			valuesBuffer->descriptorInfo(),
+			flagsBuffer->descriptorInfo(),
+			output->descriptorInfo(),
+			keptCount->descriptorInfo(),
+			count);
+		double milliseconds = runner.run([&](VkCommandBuffer commandBuffer) {
+			runner.startTimer(commandBuffer);
+			compact.compact(commandBuffer, *bindings, count);
+			runner.stopTimer(commandBuffer);
+		});
+
+		bool passed = expectEqual("compact count", readBuffer(*keptCount, 1), { static_cast<uint32_t>(expected.size()) });
+		passed = expectEqual("compact", readBuffer(*output, expected.size()), expected) && passed;
+		return { passed, milliseconds };
+	}
+
+	// binCount above GpuHistogram::SHARED_BIN_COUNT takes the global atomics path. Bins are
+	// picked so some values fall past the last one
+	CheckResult checkHistogram(VrDevice& device, ComputeRunner& runner, std::mt19937& random, uint32_t count, uint32_t binCount, uint32_t shift) {
+		std::vector<uint32_t> values = randomValues(random, count, std::numeric_limits<uint32_t>::max());
+		std::vector<uint32_t> expected(binCount, 0);
+		for (uint32_t value : values) {
+			if ((value >> shift) < binCount) {
+				expected[value >> shift]++;
+			}
+		}
+
+		auto valuesBuffer = createHostBuffer(device, values);
+		auto bins = createHostBuffer(device, binCount);
+
+		GpuHistogram histogram{ device, 1 };
+		auto bindings = histogram.createBindings(valuesBuffer->descriptorInfo(), bins->descriptorInfo());
+		double milliseconds = runner.run([&](VkCommandBuffer commandBuffer) {
+			runner.startTimer(commandBuffer);
+			histogram.histogram(commandBuffer, *bindings, count, binCount, shift);
+			runner.stopTimer(commandBuffer);
+		});
+
+		return { expectEqual("histogram", readBuffer(*bins, binCount), expected), milliseconds };
+	}
+
+	CheckResult checkSegmentedReduce(VrDevice& device, ComputeRunner& runner, std::mt19937& random, uint32_t count, ReduceOp op) {
+		std::vector<uint32_t> values = randomValues(random, count, 1000);
+
+		// Segment lengths up to a few workgroups, including empty segments
+		std::uniform_int_distribution<uint32_t> lengthDistribution{ 0, 3 * GpuSegmentedReduce::WORKGROUP_SIZE };
+		std::vector<uint32_t> segmentOffsets{ 0 };
+		while (segmentOffsets.back() < count) {
+			segmentOffsets.push_back(std::min(segmentOffsets.back() + lengthDistribution(random), count));
+		}
+		const uint32_t segmentCount = static_cast<uint32_t>(segmentOffsets.size() - 1);
+
+		std::vector<uint32_t> expected(segmentCount);
+		for (uint32_t s = 0; s < segmentCount; s++) {
+			uint32_t result = op == ReduceOp::Min ? std::numeric_limits<uint32_t>::max() : 0;
+			for (uint32_t i = segmentOffsets[s]; i < segmentOffsets[s + 1]; i++) {
+				result = op == ReduceOp::Add ? result + values[i] :
+					op == ReduceOp::Min ? std::min(result, values[i]) : std::max(result, values[i]);
+			}
+			expected[s] = result;
+		}
+
+		auto valuesBuffer = createHostBuffer(device, values);
+		auto offsetsBuffer = createHostBuffer(device, segmentOffsets);
+		auto results = createHostBuffer(device, segmentCount);
+
+		GpuSegmentedReduce reduce{ device, 1, op };
+		auto bindings = reduce.createBindings(
+			valuesBuffer->descriptorInfo(),
+			offsetsBuffer->descriptorInfo(),
+			results->descriptorInfo());
+		double milliseconds = runner.run([&](VkCommandBuffer commandBuffer) {
+			runner.startTimer(commandBuffer);
+			reduce.reduce(commandBuffer, *bindings, segmentCount);
+			runner.stopTimer(commandBuffer);
+		});
+
+		return { expectEqual("segmented reduce", readBuffer(*results, segmentCount), expected), milliseconds };
+	}
+
+	CheckResult checkRadixSort(VrDevice& device, ComputeRunner& runner, std::mt19937& random, uint32_t count, uint32_t keyWords) {
+		std::vector<uint32_t> keys = randomValues(random, static_cast<size_t>(count) * keyWords, std::numeric_limits<uint32_t>::max());
+		std::vector<uint32_t> values(count);
+		std::iota(values.begin(), values.end(), 0u);
+
+		auto keyOf = [&](uint32_t value) {
+			uint64_t key = keys[static_cast<size_t>(value) * keyWords];
+			if (keyWords == 2) {
+				key |= static_cast<uint64_t>(keys[static_cast<size_t>(value) * keyWords + 1]) << 32;
+			}
+			return key;
+		};
+
+		// Stable, so equal keys keep the order of their values
+		std::vector<uint32_t> expectedValues = values;
+		std::stable_sort(expectedValues.begin(), expectedValues.end(), [&](uint32_t a, uint32_t b) {
+			return keyOf(a) < keyOf(b);
+		});
+		std::vector<uint32_t> expectedKeys;
+		for (uint32_t value : expectedValues) {
+			for (uint32_t word = 0; word < keyWords; word++) {
+				expectedKeys.push_back(keys[static_cast<size_t>(value) * keyWords + word]);
+			}
+		}
+
+		auto keysStaging = createHostBuffer(device, keys);
+		auto valuesStaging = createHostBuffer(device, values);
+
+		GpuRadixSort sort{ device, 1, keyWords };
+		auto buffers = sort.createBuffers(count);
+		const VkDeviceSize keysSize = static_cast<VkDeviceSize>(count) * keyWords * sizeof(uint32_t);
+		const VkDeviceSize valuesSize = static_cast<VkDeviceSize>(count) * sizeof(uint32_t);
+
+		double milliseconds = runner.run([&](VkCommandBuffer commandBuffer) {
+			VkBufferCopy keysRegion{ 0, 0, keysSize };
+			VkBufferCopy valuesRegion{ 0, 0, valuesSize };
+			vkCmdCopyBuffer(commandBuffer, keysStaging->getBuffer(), buffers->keys->getBuffer(), 1, &keysRegion);
+			vkCmdCopyBuffer(commandBuffer, valuesStaging->getBuffer(), buffers->values->getBuffer(), 1, &valuesRegion);
+			memoryBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+			runner.startTimer(commandBuffer);
+			sort.sort(commandBuffer, *buffers, count);
+			runner.stopTimer(commandBuffer);
+
+			memoryBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+			vkCmdCopyBuffer(commandBuffer, buffers->keys->getBuffer(), keysStaging->getBuffer(), 1, &keysRegion);
+			vkCmdCopyBuffer(commandBuffer, buffers->values->getBuffer(), valuesStaging->getBuffer(), 1, &valuesRegion);
+		});
+
+		const std::string name = keyWords == 2 ? "radix sort (64-bit keys)" : "radix sort";
+		bool passed = expectEqual(name + " keys", readBuffer(*keysStaging, keys.size()), expectedKeys);
+		passed = expectEqual(name + " values", readBuffer(*valuesStaging, count), expectedValues) && passed;
+		return { passed, milliseconds };
+	}
+}
+
+int main() {
+	// The device needs a surface, but nothing is presented
+	glfwInit();
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	try {
+		vr::VrWindow window{ 64, 64, "GPU primitives test" };
+		vr::VrDevice device{ window };
+		ComputeRunner runner{ device };
+		std::mt19937 random{ 1234 };
+
+		struct Check {
+			const char* name;
+			std::function<CheckResult(uint32_t count)> run;
+		};
+		const std::vector<Check> checks{
+			{ "scan", [&](uint32_t count) { return checkScan(device, runner, random, count); } },
+			{ "compact", [&](uint32_t count) { return checkCompact(device, runner, random, count); } },
+			{ "histogram (shared bins)", [&](uint32_t count) { return checkHistogram(device, runner, random, count, 200, 24); } },
+			{ "histogram (global bins)", [&](uint32_t count) { return checkHistogram(device, runner, random, count, 6000, 19); } },
+			{ "segmented reduce (add)", [&](uint32_t count) { return checkSegmentedReduce(device, runner, random, count, vr::ReduceOp::Add); } },
+			{ "segmented reduce (min)", [&](uint32_t count) { return checkSegmentedReduce(device, runner, random, count, vr::ReduceOp::Min); } },
+			{ "segmented reduce (max)", [&](uint32_t count) { return checkSegmentedReduce(device, runner, random, count, vr::ReduceOp::Max); } },
+			{ "radix sort", [&](uint32_t count) { return checkRadixSort(device, runner, random, count, 1); } },
+			{ "radix sort (64-bit keys)", [&](uint32_t count) { return checkRadixSort(device, runner, random, count, 2); } },
+		};
+
+		bool passed = true;
+		for (const auto& check : checks) {
+			for (uint32_t count : { CHECK_COUNT, BENCHMARK_COUNT }) {
+				CheckResult result = check.run(count);
+				std::cout << check.name << ", " << count << " values: " << (result.passed ? "ok" : "FAILED")
+					<< ", " << result.milliseconds << " ms\n";
+				passed = passed && result.passed;
+			}
+		}
+
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+}